@@ -0,0 +1,178 @@
+/**
+ * @file Arena.c
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief implementation for Arena.h
+ *
+ * @section LICENSE
+ * This program is private and was made for the 2020 67315 course
+ */
+
+// ------------------------------ includes ------------------------------
+#include <stdlib.h>
+#include <stdint.h>
+#include "Arena.h"
+
+// -------------------------- const definitions -------------------------
+/**
+ * @def NO_RETURN_VALUE
+ * @brief return value used in void functions for the CHECK_ERROR constant
+ */
+#define NO_RETURN_VALUE ((void)(0))
+
+/**
+ * @def CHECK_ERROR
+ * @brief constant reecives a boolean expression and checks if it is true- if
+ * not return the retern value ret_val
+ */
+#define CHECK_ERROR(expression, ret_val) if(!(expression)){\
+return ret_val;\
+}
+
+/**
+ * @def SUCCESS
+ * @brief return value for int type functions in case of succession
+ */
+#define SUCCESS 1
+
+/**
+ * @def FAIL
+ * @brief return value for int type functions in case of failure
+ */
+#define FAIL 0
+
+/**
+ * @def ROUND_UP
+ * @brief rounds a size up to a multiple of ARENA_ALIGN
+ */
+#define ROUND_UP(size) (((size) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+
+/**
+ * @def HEADER_SIZE
+ * @brief bytes kept in front of the data of a slab or a large block, so the
+ * data stays aligned to ARENA_ALIGN
+ */
+#define HEADER_SIZE ROUND_UP(sizeof(struct ArenaSlab))
+
+/**
+ * @def MAX_BLOCK_SIZE
+ * @brief the biggest size ArenaMalloc accepts- rounding a bigger one up, or
+ * adding the header to it, would wrap size_t
+ */
+#define MAX_BLOCK_SIZE (SIZE_MAX - HEADER_SIZE - ARENA_ALIGN)
+
+/**
+ * @struct ArenaSlab
+ * The header of a slab (or of a large block), its data follows it.
+ * @param next the slab allocated before it.
+ */
+struct ArenaSlab {
+  struct ArenaSlab *next;
+};
+
+/**
+ * @struct ArenaBlock
+ * A released small block, kept on the free list of its size class.
+ * @param next the block released before it.
+ */
+struct ArenaBlock {
+  struct ArenaBlock *next;
+};
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * frees a list of slabs (or large blocks)
+ * @param slab the first slab of the list
+ */
+static void FreeSlabs(struct ArenaSlab *slab);
+
+/**
+ * starts a new slab to carve small blocks from
+ * @param arena Arena struct object
+ * @return 1 upon success, 0 otherwise
+ */
+static int NewSlab(Arena *arena);
+
+Arena *ArenaAlloc(void) {
+  Arena *arena = calloc(1, sizeof(Arena));
+  CHECK_ERROR(arena, NULL)
+  //no slab yet- the first small block starts one
+  arena->used = ARENA_SLAB_SIZE;
+  return arena;
+}
+
+void ArenaFree(Arena **p_arena) {
+  CHECK_ERROR(p_arena && (*p_arena), NO_RETURN_VALUE)
+  FreeSlabs((*p_arena)->slabs);
+  FreeSlabs((*p_arena)->large);
+  free(*p_arena);
+  *p_arena = NULL;
+}
+
+static void FreeSlabs(struct ArenaSlab *slab) {
+  while (slab) {
+    struct ArenaSlab *next = slab->next;
+    free(slab);
+    slab = next;
+  }
+}
+
+static int NewSlab(Arena *arena) {
+  struct ArenaSlab *slab = malloc(HEADER_SIZE + ARENA_SLAB_SIZE);
+  CHECK_ERROR(slab, FAIL)
+  slab->next = arena->slabs;
+  arena->slabs = slab;
+  arena->used = 0;
+  return SUCCESS;
+}
+
+void *ArenaMalloc(Arena *arena, size_t size) {
+  CHECK_ERROR(arena, NULL)
+  CHECK_ERROR(size <= MAX_BLOCK_SIZE, NULL)
+  size = size ? ROUND_UP(size) : ARENA_ALIGN;
+  if (size > ARENA_MAX_SMALL) {
+    //the large blocks are kept on a list of their own, like slabs
+    struct ArenaSlab *block = malloc(HEADER_SIZE + size);
+    CHECK_ERROR(block, NULL)
+    block->next = arena->large;
+    arena->large = block;
+    return (char *) block + HEADER_SIZE;
+  }
+  struct ArenaBlock **free_list = &arena->free_lists[size / ARENA_ALIGN - 1];
+  if (*free_list) {
+    struct ArenaBlock *block = *free_list;
+    *free_list = block->next;
+    return block;
+  }
+  CHECK_ERROR(arena->used + size <= ARENA_SLAB_SIZE || NewSlab(arena), NULL)
+  void *block = (char *) arena->slabs + HEADER_SIZE + arena->used;
+  arena->used += size;
+  return block;
+}
+
+void ArenaRelease(Arena *arena, void *block, size_t size) {
+  //a bigger size was never handed out
+  CHECK_ERROR(arena && block && size <= MAX_BLOCK_SIZE, NO_RETURN_VALUE)
+  size = size ? ROUND_UP(size) : ARENA_ALIGN;
+  if (size > ARENA_MAX_SMALL) {
+    return; //large blocks live until the arena is reset
+  }
+  struct ArenaBlock *released = block;
+  released->next = arena->free_lists[size / ARENA_ALIGN - 1];
+  arena->free_lists[size / ARENA_ALIGN - 1] = released;
+}
+
+void ArenaReset(Arena *arena) {
+  CHECK_ERROR(arena, NO_RETURN_VALUE)
+  if (arena->slabs) {
+    FreeSlabs(arena->slabs->next);
+    arena->slabs->next = NULL;
+    arena->used = 0;
+  }
+  FreeSlabs(arena->large);
+  arena->large = NULL;
+  for (size_t i = 0; i < ARENA_NUM_CLASSES; i++) {
+    arena->free_lists[i] = NULL;
+  }
+}
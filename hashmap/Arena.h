@@ -0,0 +1,108 @@
+/**
+ * @file Arena.h
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief a slab allocator for many small objects that die together.
+ *
+ * Small blocks (up to ARENA_MAX_SMALL bytes) are carved from big slabs, in
+ * size classes of ARENA_ALIGN bytes; a released block goes to the free list
+ * of its class and is handed out again by the next ArenaMalloc of the same
+ * class. Bigger blocks get a malloc of their own. ArenaReset gives back
+ * every block at once, without visiting them.
+ *
+ * An arena is not thread safe.
+ *
+ * A HashMap allocates its entries from an arena (HashMapOptions.arena) but
+ * never resets or frees it. Keys and values can live in the arena as well
+ * (HashMapOptions.arena_owns_keys): the PairTraits copy functions take no
+ * allocator argument, so they reach the arena through a global, as
+ * ArenaCharCpy does with test_arena in Hashmap_test.c. Such an arena must
+ * be reset or freed only after every map whose keys it holds.
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stdlib.h>
+
+/**
+ * @def ARENA_ALIGN
+ * Every block is aligned to (and its size rounded up to) this many bytes.
+ */
+#define ARENA_ALIGN 16UL
+
+/**
+ * @def ARENA_MAX_SMALL
+ * The biggest block served from the slabs.
+ */
+#define ARENA_MAX_SMALL 256UL
+
+/**
+ * @def ARENA_SLAB_SIZE
+ * The size of one slab.
+ */
+#define ARENA_SLAB_SIZE 65536UL
+
+/**
+ * @def ARENA_NUM_CLASSES
+ * The number of size classes of small blocks.
+ */
+#define ARENA_NUM_CLASSES (ARENA_MAX_SMALL / ARENA_ALIGN)
+
+struct ArenaSlab;
+struct ArenaBlock;
+
+/**
+ * @struct Arena
+ * @param slabs the slabs, the newest (the one being carved) first.
+ * @param used number of bytes carved from the newest slab.
+ * @param free_lists the released small blocks of every size class.
+ * @param large the blocks bigger than ARENA_MAX_SMALL.
+ */
+typedef struct Arena {
+  struct ArenaSlab *slabs;
+  size_t used;
+  struct ArenaBlock *free_lists[ARENA_NUM_CLASSES];
+  struct ArenaSlab *large;
+} Arena;
+
+/**
+ * Allocates dynamically new empty arena.
+ * @return pointer to dynamically allocated Arena.
+ * @if_fail return NULL.
+ */
+Arena *ArenaAlloc(void);
+
+/**
+ * Frees an arena and every block allocated from it.
+ * @param p_arena pointer to dynamically allocated pointer to the arena.
+ */
+void ArenaFree(Arena **p_arena);
+
+/**
+ * Allocates a block from the arena.
+ * @param arena an arena.
+ * @param size number of bytes (0 is treated as 1).
+ * @return pointer to the block (aligned to ARENA_ALIGN), NULL if failed
+ * (also for a size so close to SIZE_MAX that rounding it up would wrap).
+ */
+void *ArenaMalloc(Arena *arena, size_t size);
+
+/**
+ * Gives a block back to the arena, to be reused by the next ArenaMalloc of
+ * the same size class. Releasing blocks is optional: ArenaReset and
+ * ArenaFree give back all of them anyway.
+ * @param arena the arena the block was allocated from.
+ * @param block the block (NULL does nothing).
+ * @param size the size it was allocated with.
+ */
+void ArenaRelease(Arena *arena, void *block, size_t size);
+
+/**
+ * Gives back every block of the arena at once. Keeps one slab, so refilling
+ * the arena does not start with a malloc.
+ * @param arena an arena.
+ */
+void ArenaReset(Arena *arena);
+
+#endif //ARENA_H_
@@ -0,0 +1,639 @@
+/**
+ * @file ChainedBackend.c
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ * @version 1.0
+ * @date 10/12/2020
+ *
+ * @brief the HASH_MAP_CHAINED storage engine of HashMap.h - every bucket is
+ * a growing array of (hash, pair) slots, allocated when the first pair lands
+ * in it. The pairs are owned (copied and freed) by the map, whatever it
+ * stores (Pair or KeyValue).
+ * A slot keeps the full hash of its pair next to the pair: resizing takes
+ * the hash from there instead of calling hash_func, and a lookup compares
+ * keys only when the hashes match. A map that owns its arena
+ * (ENTRIES_IN_ARENA) allocates its buckets there as well, so emptying or
+ * freeing the map drops the buckets with the arena instead of one by one.
+ *
+ * With a positive resize_step a resize only allocates the new bucket array.
+ * The old array stays alive and every following find, insert and erase moves
+ * resize_step of its buckets to the new array; lookups check the new array
+ * first and then the old bucket, if it was not moved yet.
+ *
+ * @section LICENSE
+ * This program is private and was made for the 2020 67315 course
+ */
+
+// ------------------------------ includes ------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "HashMapBackend.h"
+
+// -------------------------- const definitions -------------------------
+/**
+ * @def EMPTY_BUCKET
+ * @brief size of empty bucket
+ */
+#define EMPTY_BUCKET 0
+
+/**
+ * @def BUCKET_INITIAL_SLOTS
+ * @brief the number of slots a bucket is allocated with (it doubles when it
+ * fills up)- at most HASH_MAP_MAX_LOAD_FACTOR pairs per bucket, most buckets
+ * hold one or two
+ */
+#define BUCKET_INITIAL_SLOTS 2
+
+/**
+ * @def BUCKET_BYTES
+ * @brief the size of a bucket with the given number of slots
+ */
+#define BUCKET_BYTES(capacity) \
+    (sizeof(ChainedBucket) + (capacity) * sizeof(HashMapSlot))
+
+/**
+ * @struct ChainedBucket
+ * @param size the number of pairs in the bucket.
+ * @param capacity the number of slots allocated.
+ * @param slots the pairs of the bucket and their hashes, in no particular
+ * order.
+ */
+typedef struct ChainedBucket {
+  size_t size;
+  size_t capacity;
+  HashMapSlot slots[];
+} ChainedBucket;
+
+/**
+ * @struct ChainedState
+ * The storage of a HASH_MAP_CHAINED map (its backend_state).
+ * @param buckets the bucket array, capacity buckets.
+ * @param old_buckets the bucket array still being migrated by an incremental
+ * resize, NULL if no resize is in progress.
+ * @param old_capacity the number of buckets in old_buckets.
+ * @param migrated number of old buckets already moved to buckets.
+ */
+typedef struct ChainedState {
+  ChainedBucket **buckets;
+  ChainedBucket **old_buckets;
+  size_t old_capacity;
+  size_t migrated;
+} ChainedState;
+
+/**
+ * @def STATE
+ * @brief the storage of the map (see ChainedState)
+ */
+#define STATE(hash_map) ((ChainedState *) (hash_map)->backend_state)
+
+// ------------------------------ functions -----------------------------
+
+typedef ChainedBucket *mapCellT;
+
+/**
+ * function allocates a bucket array in given size
+ * @param size size of the new dynamiclly allocated array
+ * @return pointer to new allocated array or NULL if failed
+ */
+static mapCellT *BucketsAlloc(size_t size);
+
+/**
+ * allocates a bucket with twice the slots of the given one (or
+ * BUCKET_INITIAL_SLOTS for NULL) and moves the slots to it, from the map's
+ * arena if ENTRIES_IN_ARENA
+ * @param hash_map HashMap struct object
+ * @param bucket the bucket to grow (may be NULL)
+ * @return the grown bucket, NULL if failed (bucket is left as it was)
+ */
+static ChainedBucket *BucketGrow(HashMap *hash_map, ChainedBucket *bucket);
+
+/**
+ * frees a bucket (not its pairs), or gives it back to the map's arena
+ * @param hash_map HashMap struct object
+ * @param bucket the bucket (may be NULL)
+ */
+static void BucketFree(HashMap *hash_map, ChainedBucket *bucket);
+
+/**
+ * function gets dest array and src array and moves all pairs from src
+ * array to dest array (only the pointers move, the pairs are not copied)
+ * @param hash_map HashMap struct object
+ * @param dest_buckets array of buckets to rehash to
+ * @param src_buckets array of buckets to rehash from
+ * @param dest_size number of elements of dest_buckets
+ * @param src_size number of elements of src_buckets
+ * @return 1 upon success, 0 otherwise
+ */
+static int ReHashAll(HashMap *hash_map, mapCellT *dest_buckets,
+    mapCellT *src_buckets, size_t dest_size, size_t src_size);
+
+/**
+ * function frees buckets array and everything inside it (only the array if
+ * ENTRIES_IN_ARENA- the rest goes with the arena)
+ * @param hash_map HashMap struct object
+ * @param p_buckets pointer to array of buckets to be freed
+ * @param arr_size size of the array
+ */
+static void FreeBuckets(HashMap *hash_map, mapCellT **p_buckets,
+    size_t arr_size);
+
+/**
+ * function frees buckets array and the buckets inside it, but not the pairs
+ * (used after the pairs were moved to another array)
+ * @param hash_map HashMap struct object
+ * @param p_buckets pointer to array of buckets to be freed
+ * @param arr_size size of the array
+ */
+static void FreeBucketsShallow(HashMap *hash_map, mapCellT **p_buckets,
+    size_t arr_size);
+
+/**
+ * functions vreates new buckets array and rehashes all old array to the new
+ * one so at the end of the func we get new buckets array in wanted size with
+ * all pairs in it correctly
+ * @param hash_map HashMap struct object
+ * @param p_new_buckets pointer to the pointer the new array will be kept on
+ * @param new_buckets_size number of elements in new buckets array
+ * @return 1 upon success, 0 otherwise
+ */
+static int CreateNewBuckets(HashMap *hash_map, mapCellT **p_new_buckets,
+    size_t new_buckets_size);
+
+/**
+ * returns the slot holding the pair with the given key in the bucket
+ * @param hash_map HashMap struct object
+ * @param bucket the bucket (may be NULL)
+ * @param key the key to look for
+ * @param hash the hash of key
+ * @return pointer to the slot holding the pair, NULL if not found
+ */
+static HashMapSlot *FindInBucket(HashMap *hash_map, ChainedBucket *bucket,
+    KeyT key, size_t hash);
+
+/**
+ * erases the pair with the given key from the bucket, frees the bucket if it
+ * became empty
+ * @param hash_map HashMap struct object
+ * @param p_cell pointer to the bucket
+ * @param key the key of the pair to erase
+ * @param hash the hash of key
+ * @return 1 upon success, 0 otherwise
+ */
+static int EraseFromBucket(HashMap *hash_map, mapCellT *p_cell, KeyT key,
+    size_t hash);
+
+/**
+ * pushes the pair and its hash to the given bucket (the bucket keeps the
+ * pointer), allocates or grows the bucket if needed
+ * @param hash_map HashMap struct object
+ * @param p_cell pointer to the bucket
+ * @param pair dynamically allocated pair to push
+ * @param hash the hash of the pair's key
+ * @return 1 upon success, 0 otherwise (the bucket is left as it was)
+ */
+static int PushToBucket(HashMap *hash_map, mapCellT *p_cell, Pair *pair,
+    size_t hash);
+
+/**
+ * moves every pair of an old bucket to the new bucket array, one pair at a
+ * time, so a pair is always in exactly one of the arrays
+ * @param hash_map HashMap struct object
+ * @param old_index index of the bucket in old_buckets
+ * @return 1 upon success, 0 otherwise
+ */
+static int MigrateBucket(HashMap *hash_map, size_t old_index);
+
+/**
+ * moves up to num_buckets old buckets to the new bucket array and frees the
+ * old array once it is empty
+ * @param hash_map HashMap struct object
+ * @param num_buckets number of old buckets to move
+ * @return 1 upon success, 0 otherwise
+ */
+static int MigrateStep(HashMap *hash_map, size_t num_buckets);
+
+/**
+ * allocates an empty bucket array in the given capacity
+ * @param hash_map HashMap struct object
+ * @param capacity number of buckets
+ * @return 1 upon success, 0 otherwise
+ */
+static int ChainedInit(HashMap *hash_map, size_t capacity);
+
+/**
+ * frees all buckets and the pairs inside them
+ * @param hash_map HashMap struct object
+ */
+static void ChainedDestroy(HashMap *hash_map);
+
+/**
+ * looks for the pair with the given key in its bucket
+ * @param hash_map HashMap struct object
+ * @param key the key to look for
+ * @param hash the hash of key
+ * @return pointer to the cell of the bucket holding the pair, NULL if the key
+ * is not in the map
+ */
+static Pair **ChainedFind(HashMap *hash_map, KeyT key, size_t hash);
+
+/**
+ * pushes a copy of the pair to its bucket, allocates the bucket if needed
+ * @param hash_map HashMap struct object
+ * @param pair the pair to insert (its key is not in the map)
+ * @param hash the hash of the pair's key
+ * @return 1 upon success, 0 otherwise
+ */
+static int ChainedInsert(HashMap *hash_map, Pair *pair, size_t hash);
+
+/**
+ * erases the pair with the given key from its bucket, frees the bucket if it
+ * became empty
+ * @param hash_map HashMap struct object
+ * @param key the key of the pair to erase
+ * @param hash the hash of key
+ * @return 1 upon success, 0 otherwise
+ */
+static int ChainedErase(HashMap *hash_map, KeyT key, size_t hash);
+
+/**
+ * rehashes all pairs to a new bucket array in the given capacity
+ * @param hash_map HashMap struct object
+ * @param new_capacity number of buckets of the new array
+ * @return 1 upon success, 0 otherwise
+ */
+static int ChainedResize(HashMap *hash_map, size_t new_capacity);
+
+/**
+ * returns the next pair at or after (bucket, pos) and advances the cursor
+ * @param hash_map HashMap struct object
+ * @param bucket index of the bucket of the cursor
+ * @param pos index inside the bucket of the cursor
+ * @return the pair, NULL if there are no more pairs
+ */
+static Pair *ChainedNext(HashMap *hash_map, size_t *bucket, size_t *pos);
+
+/**
+ * prefetches the bucket of the given hash
+ * @param hash_map HashMap struct object
+ * @param hash the hash a find will look for
+ */
+static void ChainedPrefetch(const HashMap *hash_map, size_t hash);
+
+/**
+ * frees all the pairs but keeps the bucket array, and the buckets (empty)
+ * for the next pairs
+ * @param hash_map HashMap struct object
+ */
+static void ChainedClear(HashMap *hash_map);
+
+/**
+ * passes the number of pairs of every bucket to HashMapStatsAddChain (and
+ * of every old bucket not migrated yet)
+ * @param hash_map HashMap struct object
+ * @param stats the report being filled
+ */
+static void ChainedStats(const HashMap *hash_map, HashMapStats *stats);
+
+const HashMapBackendOps ChainedBackendOps = {
+    ChainedInit, ChainedDestroy, ChainedFind, ChainedInsert, ChainedErase,
+    ChainedResize, ChainedNext, ChainedPrefetch, ChainedClear, ChainedStats
+};
+
+static int ChainedInit(HashMap *hash_map, size_t capacity) {
+  ChainedState *state = calloc(1, sizeof(ChainedState));
+  CHECK_ERROR(state, FAIL)
+  state->buckets = BucketsAlloc(capacity);
+  if (!state->buckets) {
+    free(state);
+    return FAIL;
+  }
+  hash_map->backend_state = state;
+  hash_map->capacity = capacity;
+  return SUCCESS;
+}
+
+static void ChainedDestroy(HashMap *hash_map) {
+  ChainedState *state = STATE(hash_map);
+  CHECK_ERROR(state, NO_RETURN_VALUE)
+  if (state->old_buckets) {
+    FreeBuckets(hash_map, &state->old_buckets, state->old_capacity);
+  }
+  FreeBuckets(hash_map, &state->buckets, hash_map->capacity);
+  free(state);
+  hash_map->backend_state = NULL;
+}
+
+static HashMapSlot *FindInBucket(HashMap *hash_map, ChainedBucket *bucket,
+    KeyT key, size_t hash) {
+  CHECK_ERROR(bucket, NULL)
+  for (size_t i = 0; i < bucket->size; i++) {
+    HashMapSlot *slot = &bucket->slots[i];
+    if (slot->hash == hash && ENTRY_HAS_KEY(hash_map, slot->pair, key)) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+static Pair **ChainedFind(HashMap *hash_map, KeyT key, size_t hash) {
+  MigrateStep(hash_map, hash_map->resize_step);
+  ChainedState *state = STATE(hash_map);
+  size_t index = hash & (hash_map->capacity - 1);
+  HashMapSlot *found = FindInBucket(hash_map, state->buckets[index], key,
+                                    hash);
+  if (!found && state->old_buckets) {
+    index = hash & (state->old_capacity - 1);
+    found = FindInBucket(hash_map, state->old_buckets[index], key, hash);
+  }
+  return found ? &found->pair : NULL;
+}
+
+static ChainedBucket *BucketGrow(HashMap *hash_map, ChainedBucket *bucket) {
+  size_t new_capacity = bucket ? 2 * bucket->capacity : BUCKET_INITIAL_SLOTS;
+  if (!ENTRIES_IN_ARENA(hash_map)) {
+    ChainedBucket *grown = realloc(bucket, BUCKET_BYTES(new_capacity));
+    CHECK_ERROR(grown, NULL)
+    grown->size = bucket ? grown->size : EMPTY_BUCKET;
+    grown->capacity = new_capacity;
+    return grown;
+  }
+  ChainedBucket *grown = ArenaMalloc(hash_map->arena,
+                                     BUCKET_BYTES(new_capacity));
+  CHECK_ERROR(grown, NULL)
+  grown->size = EMPTY_BUCKET;
+  if (bucket) {
+    memcpy(grown, bucket, BUCKET_BYTES(bucket->size));
+    BucketFree(hash_map, bucket);
+  }
+  grown->capacity = new_capacity;
+  return grown;
+}
+
+static void BucketFree(HashMap *hash_map, ChainedBucket *bucket) {
+  CHECK_ERROR(bucket, NO_RETURN_VALUE)
+  if (ENTRIES_IN_ARENA(hash_map)) {
+    ArenaRelease(hash_map->arena, bucket, BUCKET_BYTES(bucket->capacity));
+  } else {
+    free(bucket);
+  }
+}
+
+static int PushToBucket(HashMap *hash_map, mapCellT *p_cell, Pair *pair,
+    size_t hash) {
+  ChainedBucket *bucket = *p_cell;
+  if (bucket == NULL || bucket->size == bucket->capacity) {
+    bucket = BucketGrow(hash_map, bucket);
+    CHECK_ERROR(bucket, FAIL)
+    *p_cell = bucket;
+  }
+  bucket->slots[bucket->size].hash = hash;
+  bucket->slots[bucket->size].pair = pair;
+  bucket->size++;
+  return SUCCESS;
+}
+
+static int ChainedInsert(HashMap *hash_map, Pair *pair, size_t hash) {
+  MigrateStep(hash_map, hash_map->resize_step);
+  size_t index = hash & (hash_map->capacity - 1);
+  Pair *pair_copy = HashMapEntryCopy(hash_map, pair);
+  CHECK_ERROR(pair_copy, FAIL)
+  if (!PushToBucket(hash_map, &STATE(hash_map)->buckets[index], pair_copy,
+                    hash)) {
+    HashMapEntryFree(hash_map, &pair_copy);
+    return FAIL;
+  }
+  return SUCCESS;
+}
+
+static int EraseFromBucket(HashMap *hash_map, mapCellT *p_cell, KeyT key,
+    size_t hash) {
+  HashMapSlot *slot = FindInBucket(hash_map, *p_cell, key, hash);
+  CHECK_ERROR(slot, FAIL)
+  ChainedBucket *bucket = *p_cell;
+  HashMapEntryFree(hash_map, &slot->pair);
+  //the order inside a bucket does not matter- the last slot fills the hole
+  *slot = bucket->slots[--bucket->size];
+  if (bucket->size == EMPTY_BUCKET) {
+    BucketFree(hash_map, bucket);
+    *p_cell = NULL;
+  }
+  return SUCCESS;
+}
+
+static int ChainedErase(HashMap *hash_map, KeyT key, size_t hash) {
+  MigrateStep(hash_map, hash_map->resize_step);
+  ChainedState *state = STATE(hash_map);
+  size_t index = hash & (hash_map->capacity - 1);
+  if (EraseFromBucket(hash_map, &state->buckets[index], key, hash)) {
+    return SUCCESS;
+  }
+  CHECK_ERROR(state->old_buckets, FAIL)
+  index = hash & (state->old_capacity - 1);
+  return EraseFromBucket(hash_map, &state->old_buckets[index], key, hash);
+}
+
+static int MigrateBucket(HashMap *hash_map, size_t old_index) {
+  ChainedState *state = STATE(hash_map);
+  ChainedBucket *old_bucket = state->old_buckets[old_index];
+  CHECK_ERROR(old_bucket, SUCCESS)
+  while (old_bucket->size != EMPTY_BUCKET) {
+    HashMapSlot *slot = &old_bucket->slots[old_bucket->size - 1];
+    size_t where_to = slot->hash & (hash_map->capacity - 1);
+    CHECK_ERROR(PushToBucket(hash_map, &state->buckets[where_to],
+                             slot->pair, slot->hash), FAIL)
+    old_bucket->size--; //the pair moved to the new bucket
+  }
+  BucketFree(hash_map, old_bucket);
+  state->old_buckets[old_index] = NULL;
+  return SUCCESS;
+}
+
+static int MigrateStep(HashMap *hash_map, size_t num_buckets) {
+  ChainedState *state = STATE(hash_map);
+  for (; state->old_buckets && num_buckets > 0; num_buckets--) {
+    CHECK_ERROR(MigrateBucket(hash_map, state->migrated), FAIL)
+    state->migrated++;
+    if (state->migrated == state->old_capacity) {
+      free(state->old_buckets);
+      state->old_buckets = NULL;
+      state->old_capacity = 0;
+      state->migrated = 0;
+    }
+  }
+  return SUCCESS;
+}
+
+static int ChainedResize(HashMap *hash_map, size_t new_capacity) {
+  ChainedState *state = STATE(hash_map);
+  mapCellT *new_buckets = NULL;
+  if (hash_map->resize_step == 0) {
+    int new_buckets_success = CreateNewBuckets(hash_map, &new_buckets,
+                                               new_capacity);
+    CHECK_ERROR(new_buckets_success, FAIL)
+    FreeBucketsShallow(hash_map, &state->buckets, hash_map->capacity);
+    state->buckets = new_buckets;
+    hash_map->capacity = new_capacity;
+    return SUCCESS;
+  }
+  //incremental- a resize only starts once the previous one drained. until
+  //then this is one more migration step and the capacity stays (the next
+  //insert or erase asks again), so no operation migrates a whole table
+  if (state->old_buckets) {
+    CHECK_ERROR(MigrateStep(hash_map, hash_map->resize_step), FAIL)
+    CHECK_ERROR(!state->old_buckets, SUCCESS)
+  }
+  new_buckets = BucketsAlloc(new_capacity);
+  CHECK_ERROR(new_buckets, FAIL)
+  state->old_buckets = state->buckets;
+  state->old_capacity = hash_map->capacity;
+  state->migrated = 0;
+  state->buckets = new_buckets;
+  hash_map->capacity = new_capacity;
+  return SUCCESS;
+}
+
+static Pair *ChainedNext(HashMap *hash_map, size_t *bucket, size_t *pos) {
+  ChainedState *state = STATE(hash_map);
+  //the cursor walks the new buckets and then the old ones
+  for (; *bucket < hash_map->capacity + state->old_capacity;
+         (*bucket)++, *pos = 0) {
+    ChainedBucket *cur_bucket = *bucket < hash_map->capacity ?
+        state->buckets[*bucket] :
+        state->old_buckets[*bucket - hash_map->capacity];
+    if (cur_bucket != NULL && *pos < cur_bucket->size) {
+      return cur_bucket->slots[(*pos)++].pair;
+    }
+  }
+  return NULL;
+}
+
+static void ChainedPrefetch(const HashMap *hash_map, size_t hash) {
+  ChainedBucket *bucket =
+      STATE(hash_map)->buckets[hash & (hash_map->capacity - 1)];
+  if (bucket) {
+    HASH_MAP_PREFETCH(bucket);
+  }
+}
+
+static void ChainedStats(const HashMap *hash_map, HashMapStats *stats) {
+  const ChainedState *state = STATE(hash_map);
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    ChainedBucket *cur_bucket = state->buckets[i];
+    HashMapStatsAddChain(stats, cur_bucket ? cur_bucket->size : 0);
+  }
+  for (size_t i = state->migrated; state->old_buckets &&
+      i < state->old_capacity; i++) {
+    ChainedBucket *cur_bucket = state->old_buckets[i];
+    HashMapStatsAddChain(stats, cur_bucket ? cur_bucket->size : 0);
+  }
+}
+
+static void ChainedClear(HashMap *hash_map) {
+  ChainedState *state = STATE(hash_map);
+  if (state->old_buckets) {
+    FreeBuckets(hash_map, &state->old_buckets, state->old_capacity);
+    state->old_capacity = 0;
+    state->migrated = 0;
+  }
+  if (ENTRIES_IN_ARENA(hash_map)) {
+    //the buckets go with the arena as well
+    memset(state->buckets, 0, hash_map->capacity * sizeof(mapCellT));
+    return;
+  }
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    ChainedBucket *cur_bucket = state->buckets[i];
+    if (cur_bucket == NULL) {
+      continue;
+    }
+    for (size_t j = 0; j < cur_bucket->size; j++) {
+      HashMapEntryFree(hash_map, &cur_bucket->slots[j].pair);
+    }
+    cur_bucket->size = EMPTY_BUCKET;
+  }
+}
+
+static void FreeBuckets(HashMap *hash_map, mapCellT **p_buckets,
+    size_t arr_size) {
+  if (ENTRIES_IN_ARENA(hash_map)) {
+    free(*p_buckets);
+    *p_buckets = NULL;
+    return;
+  }
+  for (size_t i = 0; i < arr_size; i++) {
+    ChainedBucket *cur_bucket = (*p_buckets)[i];
+    if (cur_bucket != NULL) {
+      for (size_t j = 0; j < cur_bucket->size; j++) {
+        HashMapEntryFree(hash_map, &cur_bucket->slots[j].pair);
+      }
+    }
+  }
+  FreeBucketsShallow(hash_map, p_buckets, arr_size);
+}
+
+static void FreeBucketsShallow(HashMap *hash_map, mapCellT **p_buckets,
+    size_t arr_size) {
+  for (size_t i = 0; i < arr_size; i++) {
+    BucketFree(hash_map, (*p_buckets)[i]);
+  }
+  free(*p_buckets);
+  *p_buckets = NULL;
+}
+
+static int ReHashAll(HashMap *hash_map, mapCellT *dest_buckets,
+    mapCellT *src_buckets, size_t dest_size, size_t src_size) {
+
+  for (size_t i = 0; i < src_size; i++) {
+    if (src_buckets[i] == NULL) {
+      continue;
+    }
+    ChainedBucket *cur_bucket = src_buckets[i];
+    for (size_t j = 0; j < cur_bucket->size; j++) {
+      HashMapSlot *slot = &cur_bucket->slots[j];
+      size_t where_to = slot->hash & (dest_size - 1);
+      if (!PushToBucket(hash_map, &dest_buckets[where_to], slot->pair,
+                        slot->hash)) {
+        return FAIL;
+      }
+    }
+  }
+  return SUCCESS;
+}
+
+static mapCellT *BucketsAlloc(size_t size) {
+  /**
+   * creates new buckets list in size of 'size'
+   */
+  CHECK_ERROR(size != 0, NULL)
+  mapCellT *new_buckets = calloc(size, sizeof(mapCellT));
+  if (!new_buckets) {
+    return NULL;
+  }
+  return new_buckets;
+}
+
+static int CreateNewBuckets(HashMap *hash_map, mapCellT **p_new_buckets,
+    size_t new_buckets_size) {
+  /**
+   * creates new dynamiclly allocated buckets array in new size (old_size *
+   * GROWTH_FACTOR) and moves all pairs from old buckets to new buckets
+   * if fails rehash frees new allocated array (the pairs stay owned by the
+   * old buckets) and return FAIL
+   */
+  CHECK_ERROR(hash_map, FAIL)
+  CHECK_ERROR(p_new_buckets, FAIL)
+  CHECK_ERROR((*p_new_buckets) == NULL, FAIL)
+  CHECK_ERROR(STATE(hash_map)->buckets, FAIL)
+  CHECK_ERROR(new_buckets_size > 0, FAIL)
+  (*p_new_buckets) = BucketsAlloc(new_buckets_size);
+  if (!(*p_new_buckets)) {
+    return FAIL;
+  }
+
+  int rehash_success = ReHashAll(hash_map, (*p_new_buckets),
+                                 STATE(hash_map)->buckets, new_buckets_size,
+                                 hash_map->capacity);
+  if (rehash_success == FAIL) {
+    FreeBucketsShallow(hash_map, p_new_buckets, new_buckets_size);
+    return FAIL;
+  }
+  return SUCCESS;
+}
@@ -0,0 +1,371 @@
+/**
+ * @file ChainedInlineBackend.c
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief the HASH_MAP_CHAINED_INLINE storage engine of HashMap.h - chained
+ * buckets whose first HASH_MAP_INLINE_PAIRS (hash, pair) slots live in the
+ * bucket array itself.
+ *
+ * Below HASH_MAP_MAX_LOAD_FACTOR almost every bucket holds one or two pairs,
+ * so most buckets never allocate anything and a lookup reads the bucket and
+ * the pair, without the pointer to a slot array HASH_MAP_CHAINED follows.
+ * That costs a bigger bucket array (and no incremental resize), and on big
+ * maps buys about a third less memory per pair and faster lookups, resizes
+ * and clears (see Hashmap_bench.c). Only a bucket that gets more pairs allocates an
+ * overflow: a growing array of (hash, pair) slots for the rest of them.
+ * The inline slots of a bucket are filled from the first one, and the
+ * overflow exists only while the inline slots are all taken and it holds a
+ * pair. Like the inline slots, the overflow keeps the hash of every pair, so
+ * resizing never calls hash_func and a lookup compares keys only when the
+ * hashes match.
+ *
+ * @section LICENSE
+ * This program is private and was made for the 2020 67315 course
+ */
+
+// ------------------------------ includes ------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "HashMapBackend.h"
+
+// -------------------------- const definitions -------------------------
+/**
+ * @def EMPTY_OVERFLOW
+ * @brief size of empty overflow
+ */
+#define EMPTY_OVERFLOW 0
+
+/**
+ * @def OVERFLOW_INITIAL_SLOTS
+ * @brief the number of slots an overflow is allocated with (it doubles when
+ * it fills up)
+ */
+#define OVERFLOW_INITIAL_SLOTS 2
+
+/**
+ * @def SLOT_IS_EMPTY
+ * @brief checks if an inline slot holds no pair
+ */
+#define SLOT_IS_EMPTY(slot) ((slot).pair == NULL)
+
+/**
+ * @struct InlineOverflow
+ * The pairs of a bucket after its inline slots.
+ * @param size the number of pairs in the overflow.
+ * @param capacity the number of slots allocated.
+ * @param slots the pairs and their hashes, in no particular order.
+ */
+typedef struct InlineOverflow {
+  size_t size;
+  size_t capacity;
+  HashMapSlot slots[];
+} InlineOverflow;
+
+/**
+ * @struct HashMapInlineBucket
+ * A bucket of HASH_MAP_CHAINED_INLINE.
+ * @param slots the first pairs of the bucket, filled from the first slot.
+ * @param overflow the pairs after them, NULL while there are none.
+ */
+typedef struct HashMapInlineBucket {
+  HashMapSlot slots[HASH_MAP_INLINE_PAIRS];
+  InlineOverflow *overflow;
+} HashMapInlineBucket;
+
+/**
+ * @struct ChainedInlineState
+ * The storage of a HASH_MAP_CHAINED_INLINE map (its backend_state).
+ * @param inline_buckets the bucket array, capacity buckets.
+ */
+typedef struct ChainedInlineState {
+  HashMapInlineBucket *inline_buckets;
+} ChainedInlineState;
+
+/**
+ * @def STATE
+ * @brief the storage of the map (see ChainedInlineState)
+ */
+#define STATE(hash_map) ((ChainedInlineState *) (hash_map)->backend_state)
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * puts a pair in the first free inline slot of a bucket, or in its overflow
+ * (allocated or grown if needed)
+ * @param bucket the bucket
+ * @param pair the pair
+ * @param hash the hash of the pair's key
+ * @return 1 upon success, 0 otherwise (the bucket is not changed)
+ */
+static int PlaceInBucket(HashMapInlineBucket *bucket, Pair *pair,
+    size_t hash);
+
+/**
+ * returns the overflow slot holding the pair with the given key
+ * @param hash_map HashMap struct object
+ * @param overflow the overflow (may be NULL)
+ * @param key the key to look for
+ * @param hash the hash of key
+ * @return pointer to the slot holding the pair, NULL if not found
+ */
+static HashMapSlot *FindInOverflow(HashMap *hash_map,
+    InlineOverflow *overflow, KeyT key, size_t hash);
+
+/**
+ * frees the overflows of a bucket array and the array itself- not the
+ * pairs
+ * @param buckets the bucket array
+ * @param capacity the number of buckets
+ */
+static void FreeBucketsShallow(HashMapInlineBucket *buckets, size_t capacity);
+
+static int ChainedInlineInit(HashMap *hash_map, size_t capacity);
+static void ChainedInlineDestroy(HashMap *hash_map);
+static Pair **ChainedInlineFind(HashMap *hash_map, KeyT key, size_t hash);
+static int ChainedInlineInsert(HashMap *hash_map, Pair *pair, size_t hash);
+static int ChainedInlineErase(HashMap *hash_map, KeyT key, size_t hash);
+static int ChainedInlineResize(HashMap *hash_map, size_t new_capacity);
+static Pair *ChainedInlineNext(HashMap *hash_map, size_t *bucket,
+    size_t *pos);
+static void ChainedInlinePrefetch(const HashMap *hash_map, size_t hash);
+static void ChainedInlineClear(HashMap *hash_map);
+static void ChainedInlineStats(const HashMap *hash_map, HashMapStats *stats);
+
+const HashMapBackendOps ChainedInlineBackendOps = {
+    ChainedInlineInit, ChainedInlineDestroy, ChainedInlineFind,
+    ChainedInlineInsert, ChainedInlineErase, ChainedInlineResize,
+    ChainedInlineNext, ChainedInlinePrefetch, ChainedInlineClear,
+    ChainedInlineStats
+};
+
+static int PlaceInBucket(HashMapInlineBucket *bucket, Pair *pair,
+    size_t hash) {
+  for (size_t i = 0; i < HASH_MAP_INLINE_PAIRS; i++) {
+    if (SLOT_IS_EMPTY(bucket->slots[i])) {
+      bucket->slots[i].hash = hash;
+      bucket->slots[i].pair = pair;
+      return SUCCESS;
+    }
+  }
+  InlineOverflow *overflow = bucket->overflow;
+  if (overflow == NULL || overflow->size == overflow->capacity) {
+    size_t new_capacity = overflow ? 2 * overflow->capacity :
+        OVERFLOW_INITIAL_SLOTS;
+    overflow = realloc(overflow, sizeof(InlineOverflow) +
+                                 new_capacity * sizeof(HashMapSlot));
+    CHECK_ERROR(overflow, FAIL)
+    if (bucket->overflow == NULL) {
+      overflow->size = EMPTY_OVERFLOW;
+    }
+    overflow->capacity = new_capacity;
+    bucket->overflow = overflow;
+  }
+  overflow->slots[overflow->size].hash = hash;
+  overflow->slots[overflow->size].pair = pair;
+  overflow->size++;
+  return SUCCESS;
+}
+
+static HashMapSlot *FindInOverflow(HashMap *hash_map,
+    InlineOverflow *overflow, KeyT key, size_t hash) {
+  CHECK_ERROR(overflow, NULL)
+  for (size_t i = 0; i < overflow->size; i++) {
+    HashMapSlot *slot = &overflow->slots[i];
+    if (slot->hash == hash && ENTRY_HAS_KEY(hash_map, slot->pair, key)) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+static void FreeBucketsShallow(HashMapInlineBucket *buckets,
+    size_t capacity) {
+  for (size_t i = 0; i < capacity; i++) {
+    free(buckets[i].overflow);
+  }
+  free(buckets);
+}
+
+static int ChainedInlineInit(HashMap *hash_map, size_t capacity) {
+  CHECK_ERROR(capacity != 0, FAIL)
+  ChainedInlineState *state = malloc(sizeof(ChainedInlineState));
+  CHECK_ERROR(state, FAIL)
+  state->inline_buckets = calloc(capacity, sizeof(HashMapInlineBucket));
+  if (!state->inline_buckets) {
+    free(state);
+    return FAIL;
+  }
+  hash_map->backend_state = state;
+  hash_map->capacity = capacity;
+  return SUCCESS;
+}
+
+static void ChainedInlineDestroy(HashMap *hash_map) {
+  ChainedInlineState *state = STATE(hash_map);
+  CHECK_ERROR(state, NO_RETURN_VALUE)
+  ChainedInlineClear(hash_map);
+  free(state->inline_buckets);
+  free(state);
+  hash_map->backend_state = NULL;
+}
+
+static void ChainedInlineClear(HashMap *hash_map) {
+  ChainedInlineState *state = STATE(hash_map);
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    HashMapInlineBucket *bucket = &state->inline_buckets[i];
+    for (size_t j = 0; j < HASH_MAP_INLINE_PAIRS &&
+        !ENTRIES_IN_ARENA(hash_map); j++) {
+      if (!SLOT_IS_EMPTY(bucket->slots[j])) {
+        HashMapEntryFree(hash_map, &bucket->slots[j].pair);
+      }
+    }
+    if (bucket->overflow != NULL) {
+      for (size_t j = 0; j < bucket->overflow->size &&
+          !ENTRIES_IN_ARENA(hash_map); j++) {
+        HashMapEntryFree(hash_map, &bucket->overflow->slots[j].pair);
+      }
+      free(bucket->overflow);
+    }
+  }
+  memset(state->inline_buckets, 0,
+         hash_map->capacity * sizeof(HashMapInlineBucket));
+}
+
+static Pair **ChainedInlineFind(HashMap *hash_map, KeyT key, size_t hash) {
+  HashMapInlineBucket *bucket =
+      &STATE(hash_map)->inline_buckets[hash & (hash_map->capacity - 1)];
+  for (size_t i = 0; i < HASH_MAP_INLINE_PAIRS; i++) {
+    HashMapSlot *slot = &bucket->slots[i];
+    if (SLOT_IS_EMPTY(*slot)) {
+      return NULL; //the slots fill from the first, and overflow comes last
+    }
+    if (slot->hash == hash && ENTRY_HAS_KEY(hash_map, slot->pair, key)) {
+      return &slot->pair;
+    }
+  }
+  HashMapSlot *found = FindInOverflow(hash_map, bucket->overflow, key, hash);
+  return found ? &found->pair : NULL;
+}
+
+static int ChainedInlineInsert(HashMap *hash_map, Pair *pair, size_t hash) {
+  Pair *pair_copy = HashMapEntryCopy(hash_map, pair);
+  CHECK_ERROR(pair_copy, FAIL)
+  if (!PlaceInBucket(&STATE(hash_map)->inline_buckets[hash &
+      (hash_map->capacity - 1)], pair_copy, hash)) {
+    HashMapEntryFree(hash_map, &pair_copy);
+    return FAIL;
+  }
+  return SUCCESS;
+}
+
+static int ChainedInlineErase(HashMap *hash_map, KeyT key, size_t hash) {
+  HashMapInlineBucket *bucket =
+      &STATE(hash_map)->inline_buckets[hash & (hash_map->capacity - 1)];
+  InlineOverflow *overflow = bucket->overflow;
+  for (size_t i = 0; i < HASH_MAP_INLINE_PAIRS &&
+      !SLOT_IS_EMPTY(bucket->slots[i]); i++) {
+    if (bucket->slots[i].hash != hash ||
+        !ENTRY_HAS_KEY(hash_map, bucket->slots[i].pair, key)) {
+      continue;
+    }
+    HashMapEntryFree(hash_map, &bucket->slots[i].pair);
+    if (overflow != NULL) {
+      //the slots stay full while there is an overflow- take its last slot
+      bucket->slots[i] = overflow->slots[--overflow->size];
+      if (overflow->size == EMPTY_OVERFLOW) {
+        free(overflow);
+        bucket->overflow = NULL;
+      }
+    } else {
+      for (; i + 1 < HASH_MAP_INLINE_PAIRS; i++) {
+        bucket->slots[i] = bucket->slots[i + 1];
+      }
+      bucket->slots[i].pair = NULL;
+    }
+    return SUCCESS;
+  }
+  HashMapSlot *slot = FindInOverflow(hash_map, overflow, key, hash);
+  CHECK_ERROR(slot, FAIL)
+  HashMapEntryFree(hash_map, &slot->pair);
+  //order inside a bucket does not matter- the last slot fills the hole
+  *slot = overflow->slots[--overflow->size];
+  if (overflow->size == EMPTY_OVERFLOW) {
+    free(overflow);
+    bucket->overflow = NULL;
+  }
+  return SUCCESS;
+}
+
+static int ChainedInlineResize(HashMap *hash_map, size_t new_capacity) {
+  ChainedInlineState *state = STATE(hash_map);
+  CHECK_ERROR(new_capacity != 0, FAIL)
+  HashMapInlineBucket *new_buckets = calloc(new_capacity,
+                                            sizeof(HashMapInlineBucket));
+  CHECK_ERROR(new_buckets, FAIL)
+  size_t mask = new_capacity - 1;
+  //the old buckets are only read, so a failure leaves the map untouched
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    HashMapInlineBucket *bucket = &state->inline_buckets[i];
+    for (size_t j = 0; j < HASH_MAP_INLINE_PAIRS &&
+        !SLOT_IS_EMPTY(bucket->slots[j]); j++) {
+      size_t hash = bucket->slots[j].hash;
+      if (!PlaceInBucket(&new_buckets[hash & mask], bucket->slots[j].pair,
+                         hash)) {
+        FreeBucketsShallow(new_buckets, new_capacity);
+        return FAIL;
+      }
+    }
+    for (size_t j = 0; bucket->overflow != NULL &&
+        j < bucket->overflow->size; j++) {
+      HashMapSlot *slot = &bucket->overflow->slots[j];
+      if (!PlaceInBucket(&new_buckets[slot->hash & mask], slot->pair,
+                         slot->hash)) {
+        FreeBucketsShallow(new_buckets, new_capacity);
+        return FAIL;
+      }
+    }
+  }
+  FreeBucketsShallow(state->inline_buckets, hash_map->capacity);
+  state->inline_buckets = new_buckets;
+  hash_map->capacity = new_capacity;
+  return SUCCESS;
+}
+
+static Pair *ChainedInlineNext(HashMap *hash_map, size_t *bucket,
+    size_t *pos) {
+  HashMapInlineBucket *buckets = STATE(hash_map)->inline_buckets;
+  //pos walks the inline slots and then the overflow
+  for (; *bucket < hash_map->capacity; (*bucket)++, *pos = 0) {
+    HashMapInlineBucket *cur = &buckets[*bucket];
+    if (*pos < HASH_MAP_INLINE_PAIRS && !SLOT_IS_EMPTY(cur->slots[*pos])) {
+      return cur->slots[(*pos)++].pair;
+    }
+    if (*pos < HASH_MAP_INLINE_PAIRS) {
+      continue; //an empty slot- the rest of the bucket is empty as well
+    }
+    if (cur->overflow != NULL &&
+        *pos - HASH_MAP_INLINE_PAIRS < cur->overflow->size) {
+      return cur->overflow->slots[(*pos)++ - HASH_MAP_INLINE_PAIRS].pair;
+    }
+  }
+  return NULL;
+}
+
+static void ChainedInlineStats(const HashMap *hash_map,
+    HashMapStats *stats) {
+  const HashMapInlineBucket *buckets = STATE(hash_map)->inline_buckets;
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    const HashMapInlineBucket *bucket = &buckets[i];
+    size_t length = bucket->overflow ? bucket->overflow->size : 0;
+    for (size_t j = 0; j < HASH_MAP_INLINE_PAIRS &&
+        bucket->slots[j].pair != NULL; j++) {
+      length++;
+    }
+    HashMapStatsAddChain(stats, length);
+  }
+}
+
+static void ChainedInlinePrefetch(const HashMap *hash_map, size_t hash) {
+  HASH_MAP_PREFETCH(
+      &STATE(hash_map)->inline_buckets[hash & (hash_map->capacity - 1)]);
+}
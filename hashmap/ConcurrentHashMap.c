@@ -0,0 +1,199 @@
+/**
+ * @file ConcurrentHashMap.c
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief implementation for ConcurrentHashMap.h
+ *
+ * @section LICENSE
+ * This program is private and was made for the 2020 67315 course
+ */
+
+// ------------------------------ includes ------------------------------
+#define _POSIX_C_SOURCE 200809L //pthread_rwlock_t is POSIX, not C99
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "ConcurrentHashMap.h"
+#include "HashMapBackend.h"
+#include "Hash.h"
+
+// -------------------------- const definitions -------------------------
+/**
+ * @def CACHE_LINE
+ * @brief bytes kept between the locks of neighbour segments, so threads
+ * locking different segments do not fight over one cache line
+ */
+#define CACHE_LINE 64
+
+/**
+ * @def HASH_BITS
+ * @brief number of bits of a mixed hash
+ */
+#define HASH_BITS 64
+
+/**
+ * @struct ConcurrentHashMapSegment
+ * @param lock taken for reading by lookups and for writing by changes.
+ * @param map the pairs of the segment.
+ * @param padding keeps the next segment's lock off this cache line.
+ */
+struct ConcurrentHashMapSegment {
+  pthread_rwlock_t lock;
+  HashMap *map;
+  char padding[CACHE_LINE];
+};
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * returns the segment the key belongs to
+ * @param map ConcurrentHashMap struct object
+ * @param key the key
+ * @return the segment of key
+ */
+static struct ConcurrentHashMapSegment *SegmentOf(ConcurrentHashMap *map,
+    KeyT key);
+
+/**
+ * frees the first num_segments segments and the segment array
+ * @param map ConcurrentHashMap struct object
+ * @param num_segments number of segments that were initialized
+ */
+static void FreeSegments(ConcurrentHashMap *map, size_t num_segments);
+
+ConcurrentHashMap *ConcurrentHashMapAlloc(HashFunc hash_func,
+                                          HashMapPairCpy pair_cpy,
+                                          HashMapPairCmp pair_cmp,
+                                          HashMapPairFree pair_free,
+                                          size_t num_segments,
+                                          const HashMapOptions *options) {
+  CHECK_ERROR(hash_func || (options && options->seeded_hash), NULL)
+  CHECK_ERROR(!options || options->incremental_resize_step == 0, NULL)
+  CHECK_ERROR(!options || !options->arena, NULL) //arenas are not thread safe
+  if (num_segments == 0) {
+    num_segments = CONCURRENT_HASH_MAP_SEGMENTS;
+  }
+  unsigned segment_bits = 0;
+  while (((size_t) 1 << segment_bits) < num_segments) {
+    segment_bits++;
+  }
+  CHECK_ERROR(segment_bits < HASH_BITS, NULL)
+  ConcurrentHashMap *map = malloc(sizeof(ConcurrentHashMap));
+  CHECK_ERROR(map, NULL)
+  map->num_segments = (size_t) 1 << segment_bits;
+  map->segment_shift = HASH_BITS - segment_bits;
+  map->hash_func = hash_func;
+  map->seeded_hash = options ? options->seeded_hash : NULL;
+  map->seed = options && options->seed ? options->seed :
+      (size_t) HashMix64((uint64_t) (uintptr_t) map);
+  map->segments = malloc(map->num_segments *
+                         sizeof(struct ConcurrentHashMapSegment));
+  if (!map->segments) {
+    free(map);
+    return NULL;
+  }
+  for (size_t i = 0; i < map->num_segments; i++) {
+    struct ConcurrentHashMapSegment *segment = &map->segments[i];
+    segment->map = HashMapAllocWithOptions(hash_func, pair_cpy, pair_cmp,
+                                           pair_free, options);
+    if (!segment->map) {
+      FreeSegments(map, i);
+      free(map);
+      return NULL;
+    }
+    if (pthread_rwlock_init(&segment->lock, NULL) != 0) {
+      HashMapFree(&segment->map);
+      FreeSegments(map, i);
+      free(map);
+      return NULL;
+    }
+  }
+  return map;
+}
+
+void ConcurrentHashMapFree(ConcurrentHashMap **p_map) {
+  CHECK_ERROR(p_map && (*p_map), NO_RETURN_VALUE)
+  FreeSegments(*p_map, (*p_map)->num_segments);
+  free(*p_map);
+  *p_map = NULL;
+}
+
+static void FreeSegments(ConcurrentHashMap *map, size_t num_segments) {
+  for (size_t i = 0; i < num_segments; i++) {
+    pthread_rwlock_destroy(&map->segments[i].lock);
+    HashMapFree(&map->segments[i].map);
+  }
+  free(map->segments);
+  map->segments = NULL;
+}
+
+static struct ConcurrentHashMapSegment *SegmentOf(ConcurrentHashMap *map,
+    KeyT key) {
+  if (map->num_segments == 1) {
+    return &map->segments[0];
+  }
+  size_t hash = map->seeded_hash ? map->seeded_hash(key, map->seed) :
+      map->hash_func(key);
+  //the segment maps index their buckets with the low bits of the hash- the
+  //segment takes the high bits of the mixed hash, so both stay spread
+  return &map->segments[HashMix64((uint64_t) hash) >> map->segment_shift];
+}
+
+int ConcurrentHashMapInsert(ConcurrentHashMap *map, Pair *pair) {
+  CHECK_ERROR(map && pair, FAIL)
+  struct ConcurrentHashMapSegment *segment = SegmentOf(map, pair->key);
+  CHECK_ERROR(pthread_rwlock_wrlock(&segment->lock) == 0, FAIL)
+  int result = HashMapInsert(segment->map, pair);
+  pthread_rwlock_unlock(&segment->lock);
+  return result;
+}
+
+int ConcurrentHashMapAt(ConcurrentHashMap *map, KeyT key,
+                        HashMapValueVisitor visit, void *arg) {
+  CHECK_ERROR(map && key, FAIL)
+  struct ConcurrentHashMapSegment *segment = SegmentOf(map, key);
+  CHECK_ERROR(pthread_rwlock_rdlock(&segment->lock) == 0, FAIL)
+  ValueT value = HashMapAt(segment->map, key);
+  if (value && visit) {
+    visit(value, arg);
+  }
+  pthread_rwlock_unlock(&segment->lock);
+  return value != NULL;
+}
+
+int ConcurrentHashMapContainsKey(ConcurrentHashMap *map, KeyT key) {
+  return ConcurrentHashMapAt(map, key, NULL, NULL);
+}
+
+int ConcurrentHashMapErase(ConcurrentHashMap *map, KeyT key) {
+  CHECK_ERROR(map && key, FAIL)
+  struct ConcurrentHashMapSegment *segment = SegmentOf(map, key);
+  CHECK_ERROR(pthread_rwlock_wrlock(&segment->lock) == 0, FAIL)
+  int result = HashMapErase(segment->map, key);
+  pthread_rwlock_unlock(&segment->lock);
+  return result;
+}
+
+size_t ConcurrentHashMapGetSize(ConcurrentHashMap *map) {
+  CHECK_ERROR(map, 0)
+  size_t size = 0;
+  for (size_t i = 0; i < map->num_segments; i++) {
+    struct ConcurrentHashMapSegment *segment = &map->segments[i];
+    if (pthread_rwlock_rdlock(&segment->lock) == 0) {
+      size += segment->map->size;
+      pthread_rwlock_unlock(&segment->lock);
+    }
+  }
+  return size;
+}
+
+void ConcurrentHashMapClear(ConcurrentHashMap *map) {
+  CHECK_ERROR(map, NO_RETURN_VALUE)
+  for (size_t i = 0; i < map->num_segments; i++) {
+    struct ConcurrentHashMapSegment *segment = &map->segments[i];
+    if (pthread_rwlock_wrlock(&segment->lock) == 0) {
+      HashMapClear(segment->map);
+      pthread_rwlock_unlock(&segment->lock);
+    }
+  }
+}
@@ -0,0 +1,138 @@
+/**
+ * @file ConcurrentHashMap.h
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief a hash map that many threads may use at the same time.
+ *
+ * The map is striped: it is made of num_segments independent HashMaps
+ * (segments), every key belongs to one segment (picked by the high bits of
+ * its mixed hash) and every segment has its own reader-writer lock.
+ * Lookups of a segment run in parallel, inserts and erases lock only their
+ * segment, and a resize only rehashes (and blocks) the segment that crossed
+ * the load factor - 1 / num_segments of the map - while the other segments
+ * keep serving.
+ *
+ * Values live inside the map and may be replaced or freed by another thread
+ * at any moment, so lookups hand the value to a visitor function while the
+ * segment is locked instead of returning a pointer to it.
+ */
+
+#ifndef CONCURRENTHASHMAP_H_
+#define CONCURRENTHASHMAP_H_
+
+#include <stdlib.h>
+#include "HashMap.h"
+
+/**
+ * @def CONCURRENT_HASH_MAP_SEGMENTS
+ * The default number of segments (locks) of a concurrent hash map.
+ */
+#define CONCURRENT_HASH_MAP_SEGMENTS 64UL
+
+/**
+ * @typedef HashMapValueVisitor
+ * Receives the value of a pair found in a concurrent hash map (valid only
+ * during the call) and the argument given to the lookup.
+ */
+typedef void (*HashMapValueVisitor)(ValueT, void *);
+
+struct ConcurrentHashMapSegment;
+
+/**
+ * @struct ConcurrentHashMap
+ * @param segments the segments (a HashMap and its lock each).
+ * @param num_segments the number of segments, a power of 2.
+ * @param segment_shift a mixed hash shifted right by it is the segment index.
+ * @param hash_func a function which "hashes" keys.
+ * @param seeded_hash hashes the keys with seed instead of hash_func, NULL to
+ * use hash_func.
+ * @param seed the seed of seeded_hash.
+ */
+typedef struct ConcurrentHashMap {
+  struct ConcurrentHashMapSegment *segments;
+  size_t num_segments;
+  unsigned segment_shift;
+  HashFunc hash_func;
+  SeededHashFunc seeded_hash;
+  size_t seed;
+} ConcurrentHashMap;
+
+/**
+ * Allocates dynamically new concurrent hash map element.
+ * @param hash_func a function which "hashes" keys.
+ * @param pair_cpy a function which copies pairs.
+ * @param pair_cmp a function which compares pairs.
+ * @param pair_free a function which frees pairs.
+ * @param num_segments number of segments (rounded up to a power of 2), 0 for
+ * CONCURRENT_HASH_MAP_SEGMENTS. More segments let more writers work at once.
+ * @param options the settings of every segment, NULL for the defaults
+ * (incremental_resize_step is not supported, its lookups move pairs, and
+ * neither is an arena, which is not thread safe).
+ * @return pointer to dynamically allocated ConcurrentHashMap.
+ * @if_fail return NULL.
+ */
+ConcurrentHashMap *ConcurrentHashMapAlloc(
+    HashFunc hash_func, HashMapPairCpy pair_cpy,
+    HashMapPairCmp pair_cmp, HashMapPairFree pair_free,
+    size_t num_segments, const HashMapOptions *options);
+
+/**
+ * Frees a concurrent hash map and all its pairs. No other thread may use the
+ * map during or after the call.
+ * @param p_map pointer to dynamically allocated pointer to the map.
+ */
+void ConcurrentHashMapFree(ConcurrentHashMap **p_map);
+
+/**
+ * Inserts a copy of the pair (or replaces the pair with the same key), like
+ * HashMapInsert.
+ * @param map a concurrent hash map.
+ * @param pair a pair the map would contain.
+ * @return returns 1 for successful insertion, 0 otherwise.
+ */
+int ConcurrentHashMapInsert(ConcurrentHashMap *map, Pair *pair);
+
+/**
+ * Looks up a key and, if it is in the map, calls visit with its value while
+ * no other thread can change the pair.
+ * @param map a concurrent hash map.
+ * @param key the key to be checked.
+ * @param visit called with the value and arg if the key is found, may be
+ * NULL.
+ * @param arg passed to visit.
+ * @return 1 if the key is in the map, 0 otherwise.
+ */
+int ConcurrentHashMapAt(ConcurrentHashMap *map, KeyT key,
+                        HashMapValueVisitor visit, void *arg);
+
+/**
+ * The function checks if the given key exists in the map.
+ * @param map a concurrent hash map.
+ * @param key the key to be checked.
+ * @return 1 if the key is in the map, 0 otherwise.
+ */
+int ConcurrentHashMapContainsKey(ConcurrentHashMap *map, KeyT key);
+
+/**
+ * Erases the pair with the given key, like HashMapErase.
+ * @param map a concurrent hash map.
+ * @param key the key of the pair to be erased.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+int ConcurrentHashMapErase(ConcurrentHashMap *map, KeyT key);
+
+/**
+ * Returns the number of pairs in the map. Every segment is counted at a
+ * different moment, so with concurrent writers the result is approximate.
+ * @param map a concurrent hash map.
+ * @return the number of pairs.
+ */
+size_t ConcurrentHashMapGetSize(ConcurrentHashMap *map);
+
+/**
+ * Deletes all the pairs in the map, one segment at a time.
+ * @param map a concurrent hash map to be cleared.
+ */
+void ConcurrentHashMapClear(ConcurrentHashMap *map);
+
+#endif //CONCURRENTHASHMAP_H_
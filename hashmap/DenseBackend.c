@@ -0,0 +1,296 @@
+/**
+ * @file DenseBackend.c
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief the HASH_MAP_DENSE storage engine of HashMap.h - the pairs are kept
+ * in insertion order in one dense array of (hash, pair) entries (slots[0..
+ * size)), and the table (indices) only holds entry indices.
+ *
+ * The table is probed with Robin Hood linear probing (see
+ * RobinHoodBackend.c), an index slot holds entry index + 1 and 0 when it is
+ * empty. Erasing moves the last entry into the hole, so the entries stay
+ * dense; a resize only reallocates the entries (they keep their order) and
+ * rebuilds the table from the kept hashes.
+ * Walking the map reads the entries array from start to end and never
+ * touches an empty slot, and a table slot is a single size_t, so a probe
+ * touches fewer cache lines than a (hash, pair) slot.
+ *
+ * @section LICENSE
+ * This program is private and was made for the 2020 67315 course
+ */
+
+// ------------------------------ includes ------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "HashMapBackend.h"
+
+// -------------------------- const definitions -------------------------
+/**
+ * @def INDEX_EMPTY
+ * @brief a table slot that holds no entry
+ */
+#define INDEX_EMPTY 0
+
+/**
+ * @def ENTRIES_FOR
+ * @brief number of entries a table of the given capacity holds: the map
+ * grows before it crosses HASH_MAP_MAX_LOAD_FACTOR
+ */
+#define ENTRIES_FOR(capacity) \
+    ((size_t) ((capacity) * HASH_MAP_MAX_LOAD_FACTOR) + 1)
+
+/**
+ * @struct DenseState
+ * The storage of a HASH_MAP_DENSE map (its backend_state).
+ * @param slots the dense array of entries, the first size of them in use.
+ * @param indices for every table slot, the index + 1 of the entry in slots
+ * it points to, INDEX_EMPTY if it is empty.
+ */
+typedef struct DenseState {
+  HashMapSlot *slots;
+  size_t *indices;
+} DenseState;
+
+/**
+ * @def STATE
+ * @brief the storage of the map (see DenseState)
+ */
+#define STATE(hash_map) ((DenseState *) (hash_map)->backend_state)
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * calculates how far a table slot is from the home slot of its entry
+ * @param hash the hash of the entry the slot holds
+ * @param index the index of the table slot
+ * @param mask capacity - 1
+ * @return the probe distance of the slot
+ */
+static size_t ProbeDistance(size_t hash, size_t index, size_t mask);
+
+/**
+ * places an entry index in the table, displacing richer slots on the way
+ * @param indices the table
+ * @param entries the entries the table points to
+ * @param mask capacity - 1
+ * @param to_place the table slot to place (entry index + 1)
+ */
+static void PlaceIndex(size_t *indices, const HashMapSlot *entries,
+    size_t mask, size_t to_place);
+
+/**
+ * finds the table slot pointing to the entry with the given key
+ * @param hash_map HashMap struct object
+ * @param key the key to look for
+ * @param hash the hash of key
+ * @param p_index output - the index of the table slot
+ * @return 1 if found, 0 otherwise
+ */
+static int FindIndex(HashMap *hash_map, KeyT key, size_t hash,
+    size_t *p_index);
+
+/**
+ * fills an empty table with the first num_entries entries
+ * @param indices the table (all slots empty)
+ * @param entries the entries
+ * @param capacity the number of table slots
+ * @param num_entries the number of entries
+ */
+static void BuildIndex(size_t *indices, const HashMapSlot *entries,
+    size_t capacity, size_t num_entries);
+
+static int DenseInit(HashMap *hash_map, size_t capacity);
+static void DenseDestroy(HashMap *hash_map);
+static Pair **DenseFind(HashMap *hash_map, KeyT key, size_t hash);
+static int DenseInsert(HashMap *hash_map, Pair *pair, size_t hash);
+static int DenseErase(HashMap *hash_map, KeyT key, size_t hash);
+static int DenseResize(HashMap *hash_map, size_t new_capacity);
+static Pair *DenseNext(HashMap *hash_map, size_t *bucket, size_t *pos);
+static void DensePrefetch(const HashMap *hash_map, size_t hash);
+static void DenseClear(HashMap *hash_map);
+static void DenseStats(const HashMap *hash_map, HashMapStats *stats);
+
+const HashMapBackendOps DenseBackendOps = {
+    DenseInit, DenseDestroy, DenseFind, DenseInsert, DenseErase, DenseResize,
+    DenseNext, DensePrefetch, DenseClear, DenseStats
+};
+
+static size_t ProbeDistance(size_t hash, size_t index, size_t mask) {
+  return (index - (hash & mask)) & mask;
+}
+
+static void PlaceIndex(size_t *indices, const HashMapSlot *entries,
+    size_t mask, size_t to_place) {
+  size_t index = entries[to_place - 1].hash & mask;
+  size_t dist = 0;
+  while (indices[index] != INDEX_EMPTY) {
+    size_t cur_dist = ProbeDistance(entries[indices[index] - 1].hash, index,
+                                    mask);
+    if (cur_dist < dist) {
+      size_t tmp = indices[index];
+      indices[index] = to_place;
+      to_place = tmp;
+      dist = cur_dist;
+    }
+    index = (index + 1) & mask;
+    dist++;
+  }
+  indices[index] = to_place;
+}
+
+static int FindIndex(HashMap *hash_map, KeyT key, size_t hash,
+    size_t *p_index) {
+  DenseState *state = STATE(hash_map);
+  size_t mask = hash_map->capacity - 1;
+  size_t index = hash & mask;
+  for (size_t dist = 0; dist < hash_map->capacity; dist++) {
+    size_t entry_index = state->indices[index];
+    if (entry_index == INDEX_EMPTY) {
+      return FAIL;
+    }
+    HashMapSlot *entry = &state->slots[entry_index - 1];
+    if (ProbeDistance(entry->hash, index, mask) < dist) {
+      return FAIL;
+    }
+    if (entry->hash == hash && ENTRY_HAS_KEY(hash_map, entry->pair, key)) {
+      *p_index = index;
+      return SUCCESS;
+    }
+    index = (index + 1) & mask;
+  }
+  return FAIL;
+}
+
+static void BuildIndex(size_t *indices, const HashMapSlot *entries,
+    size_t capacity, size_t num_entries) {
+  for (size_t i = 0; i < num_entries; i++) {
+    PlaceIndex(indices, entries, capacity - 1, i + 1);
+  }
+}
+
+static int DenseInit(HashMap *hash_map, size_t capacity) {
+  CHECK_ERROR(capacity != 0, FAIL)
+  DenseState *state = malloc(sizeof(DenseState));
+  CHECK_ERROR(state, FAIL)
+  state->indices = calloc(capacity, sizeof(size_t));
+  state->slots = malloc(ENTRIES_FOR(capacity) * sizeof(HashMapSlot));
+  if (!state->indices || !state->slots) {
+    free(state->indices);
+    free(state->slots);
+    free(state);
+    return FAIL;
+  }
+  hash_map->backend_state = state;
+  hash_map->capacity = capacity;
+  return SUCCESS;
+}
+
+static void DenseDestroy(HashMap *hash_map) {
+  DenseState *state = STATE(hash_map);
+  CHECK_ERROR(state, NO_RETURN_VALUE)
+  DenseClear(hash_map);
+  free(state->slots);
+  free(state->indices);
+  free(state);
+  hash_map->backend_state = NULL;
+}
+
+static Pair **DenseFind(HashMap *hash_map, KeyT key, size_t hash) {
+  DenseState *state = STATE(hash_map);
+  size_t index = 0;
+  CHECK_ERROR(FindIndex(hash_map, key, hash, &index), NULL)
+  return &state->slots[state->indices[index] - 1].pair;
+}
+
+static int DenseInsert(HashMap *hash_map, Pair *pair, size_t hash) {
+  DenseState *state = STATE(hash_map);
+  //the map grew before the insert, so entry number size is allocated
+  HashMapSlot *entry = &state->slots[hash_map->size];
+  entry->pair = HashMapEntryCopy(hash_map, pair);
+  CHECK_ERROR(entry->pair, FAIL)
+  entry->hash = hash;
+  PlaceIndex(state->indices, state->slots, hash_map->capacity - 1,
+             hash_map->size + 1);
+  return SUCCESS;
+}
+
+static int DenseErase(HashMap *hash_map, KeyT key, size_t hash) {
+  DenseState *state = STATE(hash_map);
+  size_t index = 0;
+  CHECK_ERROR(FindIndex(hash_map, key, hash, &index), FAIL)
+  size_t entry_index = state->indices[index] - 1;
+  HashMapEntryFree(hash_map, &state->slots[entry_index].pair);
+
+  //backward shift: pull the rest of the cluster one slot closer to home
+  size_t mask = hash_map->capacity - 1;
+  size_t next = (index + 1) & mask;
+  while (state->indices[next] != INDEX_EMPTY &&
+      ProbeDistance(state->slots[state->indices[next] - 1].hash, next,
+                    mask) != 0) {
+    state->indices[index] = state->indices[next];
+    index = next;
+    next = (next + 1) & mask;
+  }
+  state->indices[index] = INDEX_EMPTY;
+
+  //move the last entry into the hole and point its table slot there
+  size_t last = hash_map->size - 1;
+  if (entry_index != last) {
+    state->slots[entry_index] = state->slots[last];
+    index = state->slots[entry_index].hash & mask;
+    while (state->indices[index] != last + 1) {
+      index = (index + 1) & mask;
+    }
+    state->indices[index] = entry_index + 1;
+  }
+  return SUCCESS;
+}
+
+static int DenseResize(HashMap *hash_map, size_t new_capacity) {
+  DenseState *state = STATE(hash_map);
+  CHECK_ERROR(new_capacity != 0, FAIL)
+  CHECK_ERROR(hash_map->size <= ENTRIES_FOR(new_capacity), FAIL)
+  size_t *new_indices = calloc(new_capacity, sizeof(size_t));
+  CHECK_ERROR(new_indices, FAIL)
+  //realloc keeps the entries (and their order), only the table is rebuilt
+  HashMapSlot *new_entries = realloc(state->slots,
+      ENTRIES_FOR(new_capacity) * sizeof(HashMapSlot));
+  if (!new_entries) {
+    free(new_indices);
+    return FAIL;
+  }
+  BuildIndex(new_indices, new_entries, new_capacity, hash_map->size);
+  free(state->indices);
+  state->indices = new_indices;
+  state->slots = new_entries;
+  hash_map->capacity = new_capacity;
+  return SUCCESS;
+}
+
+static Pair *DenseNext(HashMap *hash_map, size_t *bucket, size_t *pos) {
+  (void) pos;
+  CHECK_ERROR(*bucket < hash_map->size, NULL)
+  return STATE(hash_map)->slots[(*bucket)++].pair;
+}
+
+static void DenseClear(HashMap *hash_map) {
+  DenseState *state = STATE(hash_map);
+  for (size_t i = 0; i < hash_map->size && !ENTRIES_IN_ARENA(hash_map); i++) {
+    HashMapEntryFree(hash_map, &state->slots[i].pair);
+  }
+  memset(state->indices, 0, hash_map->capacity * sizeof(size_t));
+}
+
+static void DenseStats(const HashMap *hash_map, HashMapStats *stats) {
+  const DenseState *state = STATE(hash_map);
+  size_t mask = hash_map->capacity - 1;
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    size_t entry_index = state->indices[i];
+    HashMapStatsAddChain(stats, entry_index == INDEX_EMPTY ? 0 :
+        ProbeDistance(state->slots[entry_index - 1].hash, i, mask) + 1);
+  }
+}
+
+static void DensePrefetch(const HashMap *hash_map, size_t hash) {
+  HASH_MAP_PREFETCH(&STATE(hash_map)->indices[hash & (hash_map->capacity - 1)]);
+}
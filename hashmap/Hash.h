@@ -2,11 +2,13 @@
 #define HASH_H_
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
 /**
  * Integers simple hash func.
  */
-size_t HashInt(void *elem){
+static inline size_t HashInt(void *elem){
   size_t hash = (*((int *) elem));
   return hash;
 }
@@ -14,7 +16,7 @@ size_t HashInt(void *elem){
 /**
  * Chars simple hash func.
  */
-size_t HashChar(void *elem){
+static inline size_t HashChar(void *elem){
   size_t hash = (*((char *) elem));
   return hash;
 }
@@ -22,9 +24,167 @@ size_t HashChar(void *elem){
 /**
  * Doubles simple hash func.
  */
-size_t HashDouble(void *elem){
+static inline size_t HashDouble(void *elem){
   size_t hash = (*((double *) elem));
   return hash;
 }
 
+// ---------------------------- strong hashes ---------------------------
+// The simple hashes above keep the key's low bits as they are, so keys that
+// share low bits (aligned ids, timestamps, doubles in [0,1)) share a bucket.
+// The hashes below mix every input bit into every output bit. The Seeded
+// versions match SeededHashFunc of HashMap.h (HashMapOptions.seeded_hash).
+
+/**
+ * @def HASH_PRIME_1, HASH_PRIME_2, HASH_PRIME_3
+ * @brief odd 64 bit constants of the byte hash (from wyhash)
+ */
+#define HASH_PRIME_1 0xa0761d6478bd642fULL
+#define HASH_PRIME_2 0xe7037ed1a0b428dbULL
+#define HASH_PRIME_3 0x8ebc6af09c88c6e3ULL
+
+/**
+ * Mixes all the bits of x into all the bits of the result (the splitmix64
+ * finalizer). A bijection: different inputs never collide.
+ */
+static inline uint64_t HashMix64(uint64_t x){
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+/**
+ * Multiplies a and b to 128 bits and folds the two halves together.
+ */
+static inline uint64_t HashMum(uint64_t a, uint64_t b){
+#ifdef __SIZEOF_INT128__
+  __uint128_t product = (__uint128_t) a * b;
+  return (uint64_t) product ^ (uint64_t) (product >> 64);
+#else
+  uint64_t a_hi = a >> 32, a_lo = (uint32_t) a;
+  uint64_t b_hi = b >> 32, b_lo = (uint32_t) b;
+  uint64_t hi_hi = a_hi * b_hi, hi_lo = a_hi * b_lo;
+  uint64_t lo_hi = a_lo * b_hi, lo_lo = a_lo * b_lo;
+  uint64_t mid = (lo_lo >> 32) + (uint32_t) hi_lo + (uint32_t) lo_hi;
+  uint64_t low = (mid << 32) | (uint32_t) lo_lo;
+  uint64_t high = hi_hi + (hi_lo >> 32) + (lo_hi >> 32) + (mid >> 32);
+  return low ^ high;
+#endif
+}
+
+/**
+ * Reads 8 bytes (in any alignment).
+ */
+static inline uint64_t HashRead64(const unsigned char *p){
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+/**
+ * Reads the last 1..7 bytes of a buffer into a word.
+ */
+static inline uint64_t HashReadTail(const unsigned char *p, size_t len){
+  uint64_t value = 0;
+  memcpy(&value, p, len);
+  return value;
+}
+
+/**
+ * Hashes len bytes with the given seed (a wyhash style hash: 16 bytes per
+ * 64x64->128 bit multiply).
+ */
+static inline size_t HashBytes(const void *data, size_t len, size_t seed){
+  const unsigned char *p = data;
+  uint64_t state = (uint64_t) seed ^ HashMix64((uint64_t) seed ^ HASH_PRIME_1);
+  uint64_t a = 0, b = 0;
+  size_t left = len;
+  while (left > 16) {
+    state = HashMum(HashRead64(p) ^ HASH_PRIME_2,
+                    HashRead64(p + 8) ^ state);
+    p += 16;
+    left -= 16;
+  }
+  if (left > 8) {
+    a = HashRead64(p);
+    b = HashRead64(p + left - 8);
+  } else if (left == 8) {
+    a = HashRead64(p);
+  } else if (left > 0) {
+    a = HashReadTail(p, left);
+  }
+  return (size_t) HashMum(HASH_PRIME_3 ^ len,
+                          HashMum(a ^ HASH_PRIME_2, b ^ state));
+}
+
+/**
+ * Integers strong hash func with a seed.
+ */
+static inline size_t HashIntSeeded(void *elem, size_t seed){
+  return (size_t) HashMix64((uint64_t) (unsigned int) (*((int *) elem)) ^
+                            HashMix64((uint64_t) seed));
+}
+
+/**
+ * Chars strong hash func with a seed.
+ */
+static inline size_t HashCharSeeded(void *elem, size_t seed){
+  return (size_t) HashMix64((uint64_t) (unsigned char) (*((char *) elem)) ^
+                            HashMix64((uint64_t) seed));
+}
+
+/**
+ * Doubles strong hash func with a seed. Hashes the bits of the double, so
+ * 0.25 and 0.5 do not collide; 0.0 and -0.0 (equal values) hash the same,
+ * and so do all the NaNs.
+ */
+static inline size_t HashDoubleSeeded(void *elem, size_t seed){
+  double value = *((double *) elem);
+  uint64_t bits = 0;
+  if (value != value) {
+    bits = 0x7ff8000000000000ULL;
+  } else if (value != 0.0) {
+    memcpy(&bits, &value, sizeof(bits));
+  }
+  return (size_t) HashMix64(bits ^ HashMix64((uint64_t) seed));
+}
+
+/**
+ * Null terminated strings strong hash func with a seed.
+ */
+static inline size_t HashStringSeeded(void *elem, size_t seed){
+  return HashBytes(elem, strlen((const char *) elem), seed);
+}
+
+/**
+ * Integers strong hash func.
+ */
+static inline size_t HashIntStrong(void *elem){
+  return HashIntSeeded(elem, 0);
+}
+
+/**
+ * Chars strong hash func.
+ */
+static inline size_t HashCharStrong(void *elem){
+  return HashCharSeeded(elem, 0);
+}
+
+/**
+ * Doubles strong hash func.
+ */
+static inline size_t HashDoubleStrong(void *elem){
+  return HashDoubleSeeded(elem, 0);
+}
+
+/**
+ * Null terminated strings strong hash func.
+ */
+static inline size_t HashString(void *elem){
+  return HashStringSeeded(elem, 0);
+}
+
 #endif // HASH_H_
@@ -12,29 +12,19 @@
 
 // ------------------------------ includes ------------------------------
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 #include "HashMap.h"
+#include "HashMapBackend.h"
+#include "Hash.h"
 
 // -------------------------- const definitions -------------------------
-/**
- * @def NO_RETURN_VALUE
- * @brief return value used in void functions for the CHECK_ERROR constant
- */
-#define NO_RETURN_VALUE ((void)(0))
-
-/**
- * @def CHECK_ERROR
- * @brief constant reecives a boolean expression and checks if it is true- if
- * not return the retern value ret_val
- */
-#define CHECK_ERROR(expression, ret_val) if(!(expression)){\
-return ret_val;\
-}
-
 /**
  * @def LOAD_FACTOR
  * @brief calculation of "fake" load factor for the clear function
  */
-#define LOAD_FACTOR(size, capacity) (double)size / capacity
+#define LOAD_FACTOR(size, capacity) ((double) (size) / (capacity))
 
 /**
  * @def LOAD_FACTOR_FAIL
@@ -43,100 +33,114 @@ return ret_val;\
 #define LOAD_FACTOR_FAIL -1
 
 /**
- * @def SUCCESS
- * @brief return value for int type functions in case of succession
+ * @def MAX_CAPACITY
+ * @brief the largest capacity a map grows from- growing it once more would
+ * wrap size_t (in the capacity or in the size of its slot array)
  */
-#define SUCCESS 1
+#define MAX_CAPACITY (SIZE_MAX / HASH_MAP_GROWTH_FACTOR / sizeof(HashMapSlot))
 
 /**
- * @def FAIL
- * @brief return value for int type functions in case of failure
+ * @def BATCH_BLOCK
+ * @brief number of keys the batch functions hash and prefetch before they
+ * look the first of them up
  */
-#define FAIL 0
+#define BATCH_BLOCK 16
 
 /**
- * @def EQUALS
- * @brief return value for compare functions in case the items are equal
+ * @def COUNT_TO_VALUE, VALUE_TO_COUNT
+ * @brief an entry of the value index keeps the number of pairs holding its
+ * value as the entry's value itself (never 0, so never NULL)
  */
-#define EQUALS 1
+#define COUNT_TO_VALUE(count) ((ValueT) (uintptr_t) (count))
+#define VALUE_TO_COUNT(value) ((size_t) (uintptr_t) (value))
+
+// ------------------------------ functions -----------------------------
 
 /**
- * @def RESIZED
- * @brief flag symbolizing if a buckets array got resize
+ * returns the operations of the given storage engine
+ * @param backend the storage engine
+ * @return pointer to the engine's operations, NULL if the engine is unknown
  */
-#define RESIZED 1
+static const HashMapBackendOps *BackendOpsOf(HashMapBackend backend);
 
 /**
- * @def EMPTY_VECTOR
- * @brief size of empty vector
+ * draws a seed for a map that was not given one- different for every map of
+ * the process and for every run
+ * @param hash_map the map the seed is for
+ * @return the seed (never 0)
  */
-#define EMPTY_VECTOR 0
-
-// ------------------------------ functions -----------------------------
-
-typedef Vector *mapCellT;
+static size_t RandomSeed(const HashMap *hash_map);
 
 /**
- * the function look for a pair with the given key and returns pointer to it
+ * grows the map (with one resize) so extra more pairs fit in it without
+ * crossing HASH_MAP_MAX_LOAD_FACTOR
  * @param hash_map HashMap struct object
- * @param key key of a pair we want to find (void*)
- * @return pointer to the pair if found, NULL otherwise
+ * @param extra number of pairs about to be inserted
+ * @return 1 upon success, 0 otherwise
  */
-static Pair *HashMapGetPairByKey(HashMap *hash_map, KeyT key);
+static int GrowFor(HashMap *hash_map, size_t extra);
 
 /**
- * function allocates a bucket array in given size
- * @param size size of the new dynamiclly allocated array
- * @return pointer to new allocated array or NULL if failed
+ * resizes the map to the given capacity with its backend, and counts the
+ * resize (HASH_MAP_STATS only)
+ * @param hash_map HashMap struct object
+ * @param new_capacity the capacity to resize to
+ * @return 1 upon success, 0 otherwise
  */
-static mapCellT *BucketsAlloc(size_t size);
+static int Resize(HashMap *hash_map, size_t new_capacity);
 
 /**
- * function gets dest array and src array and rehashes all pairs from src
- * array to dest array
+ * inserts (or replaces) a copy of the pair whose key has the given hash
  * @param hash_map HashMap struct object
- * @param dest_buckets array of buckets to rehash to
- * @param src_buckets array of buckets to rehash from
- * @param dest_size number of elements of dest_buckets
- * @param src_size number of elements of src_buckets
+ * @param pair the pair to insert
+ * @param hash the hash of the pair's key
+ * @param extra the number of pairs to make room for if the key is new, 0 if
+ * the caller already made room
  * @return 1 upon success, 0 otherwise
  */
-static int ReHashAll(HashMap *hash_map, mapCellT *dest_buckets, mapCellT
-*src_buckets, size_t dest_size, size_t src_size);
+static int InsertHashed(HashMap *hash_map, Pair *pair, size_t hash,
+    size_t extra);
+
+/**
+ * pair functions of the value index, whose entries are Pairs of a value copy
+ * and a count
+ */
+static void *IndexEntryCpy(const void *entry);
+static int IndexEntryCmp(const void *entry_1, const void *entry_2);
+static void IndexEntryFree(void **p_entry);
 
 /**
- * function frees buckets array and everything inside it
- * @param p_buckets pointer to array of buckets to be freed
- * @param arr_size size of the array
+ * value functions of the count in an entry of the value index- the count is
+ * kept in the pointer itself
  */
-static void FreeBuckets(mapCellT **p_buckets, size_t arr_size);
+static ValueT CountKeep(ValueT count);
+static int CountSame(ValueT count_1, ValueT count_2);
+static void CountForget(ValueT *p_count);
 
 /**
- * function inserts new pair in correct position- allocates new vector if
- * there is none in the spot that the new pair should go to, and replaces
- * pairs if there is a pair with the same key already in map
+ * counts one more pair holding the value of the given pair in the value
+ * index (does nothing if the map has no value index)
  * @param hash_map HashMap struct object
- * @param index_to_insert index of a vector in buckets array we want to
- * insert to
- * @param pair_to_insert pointer to the pair we want to insert
+ * @param pair the pair (its value functions are used if the map has no
+ * traits)
  * @return 1 upon success, 0 otherwise
  */
-static int VectorInsert(HashMap *hash_map, size_t index_to_insert, Pair
-*pair_to_insert);
+static int ValueIndexAdd(HashMap *hash_map, const Pair *pair);
 
 /**
- * functions vreates new buckets array and rehashes all old array to the new
- * one so at the end of the func we get new buckets array in wanted size with
- * all pairs in it correctly
+ * counts one pair less holding the given value in the value index, and
+ * forgets the value when no pair holds it (does nothing if the map has no
+ * value index)
  * @param hash_map HashMap struct object
- * @param p_new_buckets pointer to the pointer the new array will be kept on
- * @param old_buckets pointer to old buckets array
- * @param new_buckets_size number of elements in new buckets array
- * @param old_buckets_size number of elements in old buckets array
- * @return 1 upon success, 0 otherwise
+ * @param value the value (still held by the map)
  */
-static int CreateNewBuckets(HashMap *hash_map, mapCellT **p_new_buckets,
-    mapCellT *old_buckets, size_t new_buckets_size, size_t old_buckets_size);
+static void ValueIndexRemove(HashMap *hash_map, ValueT value);
+
+/**
+ * returns the smallest power of 2 that is at least num (1 for 0), num must
+ * be at most MAX_CAPACITY
+ */
+static size_t RoundUpPowerOf2(size_t num);
 
 /**
  * calculates the decrement in capacity size in the map during clearing it so
@@ -144,45 +148,194 @@ static int CreateNewBuckets(HashMap *hash_map, mapCellT **p_new_buckets,
  * @param vector_size size of the vector being erased
  * @param p_map_size size that the map should have at this point
  * @param p_map_capacity capacity that the map should have at this point
+ * @param shrink_load_factor the load factor the map shrinks below
  *
  * what it does? calculates the size the map should have according
- * MIN_LOAD_FACTOR and updates the capacity the map should have after erasing
- * all pairs in the vector
+ * shrink_load_factor and updates the capacity the map should have after
+ * erasing all pairs in the vector
  */
 static void UpdateCapacityAndSize(size_t vector_size, size_t *p_map_size,
-    size_t *p_map_capacity);
+    size_t *p_map_capacity, double shrink_load_factor);
 
 
 HashMap *HashMapAlloc(HashFunc hash_func, HashMapPairCpy pair_cpy,
                       HashMapPairCmp pair_cmp, HashMapPairFree pair_free) {
+  return HashMapAllocWithOptions(hash_func, pair_cpy, pair_cmp, pair_free,
+                                 NULL);
+}
+
+HashMap *HashMapAllocWithCapacity(HashFunc hash_func, HashMapPairCpy pair_cpy,
+                                  HashMapPairCmp pair_cmp,
+                                  HashMapPairFree pair_free,
+                                  size_t num_pairs) {
+  HashMapOptions options = {0};
+  options.initial_pairs = num_pairs;
+  return HashMapAllocWithOptions(hash_func, pair_cpy, pair_cmp, pair_free,
+                                 &options);
+}
 
-  CHECK_ERROR(hash_func && pair_cpy && pair_cmp && pair_free, NULL)
+HashMap *HashMapAllocWithOptions(HashFunc hash_func, HashMapPairCpy pair_cpy,
+                                 HashMapPairCmp pair_cmp,
+                                 HashMapPairFree pair_free,
+                                 const HashMapOptions *options) {
+
+  static const HashMapOptions default_options; //all zero- the defaults
+  if (!options) {
+    options = &default_options;
+  }
+  CHECK_ERROR(hash_func || options->seeded_hash, NULL)
+  CHECK_ERROR(options->traits || (pair_cpy && pair_cmp && pair_free), NULL)
+  HashMapBackend backend = options->backend;
+  const HashMapBackendOps *ops = BackendOpsOf(backend);
+  CHECK_ERROR(ops, NULL)
+  CHECK_ERROR(options->incremental_resize_step == 0 ||
+              backend == HASH_MAP_CHAINED, NULL)
+  CHECK_ERROR(options->shrink_policy == HASH_MAP_SHRINK_ON_ERASE ||
+              options->shrink_policy == HASH_MAP_SHRINK_MANUAL, NULL)
+  const PairTraits *traits = options->traits;
+  CHECK_ERROR(!traits || (!traits->key_free) == (!traits->value_free), NULL)
+  CHECK_ERROR(!traits || (traits->key_free == NULL) ==
+              (options->arena_owns_keys != 0), NULL)
+  CHECK_ERROR(!options->arena || traits, NULL)
+  CHECK_ERROR(!options->arena_owns_keys || options->arena, NULL)
+  CHECK_ERROR(!options->map_owns_arena || options->arena_owns_keys, NULL)
+  CHECK_ERROR(!options->value_hash || !traits || traits->value_free, NULL)
+  CHECK_ERROR(options->shrink_load_factor >= 0 &&
+              options->shrink_load_factor < HASH_MAP_MAX_LOAD_FACTOR /
+              HASH_MAP_GROWTH_FACTOR, NULL)
+  CHECK_ERROR(options->min_capacity <= MAX_CAPACITY, NULL)
+  size_t min_capacity = options->min_capacity ?
+      RoundUpPowerOf2(options->min_capacity) : 0;
+  size_t capacity = HASH_MAP_INITIAL_CAP;
+  while (capacity < min_capacity ||
+      LOAD_FACTOR(options->initial_pairs, capacity) >
+      HASH_MAP_MAX_LOAD_FACTOR) {
+    CHECK_ERROR(capacity <= MAX_CAPACITY, NULL)
+    capacity *= HASH_MAP_GROWTH_FACTOR;
+  }
   HashMap *hash_map = malloc(sizeof(HashMap));
   CHECK_ERROR(hash_map, NULL)
-  mapCellT *bucket_arr = calloc(HASH_MAP_INITIAL_CAP, sizeof(mapCellT));
-  if (!bucket_arr) {
-    free(hash_map);
-    return NULL;
-  }
-  hash_map->buckets = bucket_arr;
+  hash_map->backend_state = NULL;
+  hash_map->resize_step = options->incremental_resize_step;
   hash_map->size = 0;
-  hash_map->capacity = HASH_MAP_INITIAL_CAP;
+  hash_map->capacity = 0;
   hash_map->hash_func = hash_func;
   hash_map->pair_free = pair_free;
   hash_map->pair_cpy = pair_cpy;
   hash_map->pair_cmp = pair_cmp;
+  hash_map->traits = options->traits;
+  hash_map->seeded_hash = options->seeded_hash;
+  hash_map->seed = options->seed;
+  if (hash_map->seeded_hash && hash_map->seed == 0) {
+    hash_map->seed = RandomSeed(hash_map);
+  }
+  hash_map->min_capacity = min_capacity;
+  hash_map->shrink_policy = options->shrink_policy;
+  hash_map->shrink_load_factor = options->shrink_load_factor ?
+      options->shrink_load_factor : HASH_MAP_MIN_LOAD_FACTOR;
+  hash_map->value_hash = options->value_hash;
+  hash_map->value_index = NULL;
+  hash_map->arena = options->arena;
+  hash_map->arena_owns_keys = options->arena_owns_keys;
+  //a failed allocation leaves the arena to the caller
+  hash_map->map_owns_arena = 0;
+  hash_map->backend = backend;
+  hash_map->ops = ops;
+  memset(&hash_map->counters, 0, sizeof(HashMapCounters));
+  if (!ops->init(hash_map, capacity)) {
+    free(hash_map);
+    return NULL;
+  }
+  if (hash_map->value_hash) {
+    hash_map->value_index = HashMapAlloc(hash_map->value_hash, IndexEntryCpy,
+                                         IndexEntryCmp, IndexEntryFree);
+    if (!hash_map->value_index) {
+      HashMapFree(&hash_map);
+      return NULL;
+    }
+  }
+  hash_map->map_owns_arena = options->map_owns_arena;
   return hash_map;
 }
 
+static const HashMapBackendOps *BackendOpsOf(HashMapBackend backend) {
+  switch (backend) {
+    case HASH_MAP_CHAINED:
+      return &ChainedBackendOps;
+    case HASH_MAP_ROBIN_HOOD:
+      return &RobinHoodBackendOps;
+    case HASH_MAP_SWISS:
+      return &SwissBackendOps;
+    case HASH_MAP_DENSE:
+      return &DenseBackendOps;
+    case HASH_MAP_CHAINED_INLINE:
+      return &ChainedInlineBackendOps;
+    default:
+      return NULL;
+  }
+}
+
+static size_t RandomSeed(const HashMap *hash_map) {
+  static uint64_t maps_seeded = 0;
+  //maps are allocated from many threads (ConcurrentHashMap, SnapshotHashMap)
+#if defined(__GNUC__) || defined(__clang__)
+  uint64_t map_number = __atomic_add_fetch(&maps_seeded, 1, __ATOMIC_RELAXED);
+#else
+  uint64_t map_number = ++maps_seeded;
+#endif
+  uint64_t entropy = HashMix64((uint64_t) time(NULL));
+  entropy = HashMix64(entropy ^ (uint64_t) clock());
+  entropy = HashMix64(entropy ^ (uint64_t) (uintptr_t) hash_map);
+  entropy = HashMix64(entropy ^ map_number);
+  return entropy ? (size_t) entropy : 1;
+}
+
+HashMap *HashMapCopy(HashMap *hash_map) {
+  CHECK_ERROR(hash_map, NULL)
+  //two maps can not both reset one arena
+  CHECK_ERROR(!hash_map->map_owns_arena, NULL)
+  HashMapOptions options = {0};
+  options.backend = hash_map->backend;
+  options.traits = hash_map->traits;
+  options.seeded_hash = hash_map->seeded_hash;
+  options.seed = hash_map->seed;
+  options.incremental_resize_step = hash_map->resize_step;
+  options.initial_pairs = hash_map->size;
+  options.min_capacity = hash_map->min_capacity;
+  options.shrink_policy = hash_map->shrink_policy;
+  options.shrink_load_factor = hash_map->shrink_load_factor;
+  options.value_hash = hash_map->value_hash;
+  options.arena = hash_map->arena;
+  options.arena_owns_keys = hash_map->arena_owns_keys;
+  HashMap *copy = HashMapAllocWithOptions(hash_map->hash_func,
+      hash_map->pair_cpy, hash_map->pair_cmp, hash_map->pair_free, &options);
+  CHECK_ERROR(copy, NULL)
+  size_t bucket = 0, pos = 0;
+  Pair *cur_pair = NULL;
+  while ((cur_pair = hash_map->ops->next(hash_map, &bucket, &pos)) != NULL) {
+    //the keys are unique and the copy has room- insert without looking
+    //for the key first
+    if (!copy->ops->insert(copy, cur_pair, HASH_KEY(copy, cur_pair->key))) {
+      HashMapFree(&copy);
+      return NULL;
+    }
+    copy->size++;
+    if (!ValueIndexAdd(copy, cur_pair)) {
+      HashMapFree(&copy);
+      return NULL;
+    }
+  }
+  return copy;
+}
+
 void HashMapFree(HashMap **p_hash_map) {
 
   CHECK_ERROR(p_hash_map && (*p_hash_map), NO_RETURN_VALUE)
-  if ((*p_hash_map)->size != 0) {
-    for (size_t i = 0; i < (*p_hash_map)->capacity; i++) {
-      VectorFree(&(*p_hash_map)->buckets[i]);
-    }
+  HashMapFree(&(*p_hash_map)->value_index);
+  (*p_hash_map)->ops->destroy(*p_hash_map);
+  if ((*p_hash_map)->map_owns_arena) {
+    ArenaFree(&(*p_hash_map)->arena);
   }
-  free((*p_hash_map)->buckets);
   free(*p_hash_map);
   *p_hash_map = NULL;
 }
@@ -196,195 +349,137 @@ double HashMapGetLoadFactor(HashMap *hash_map) {
   return LOAD_FACTOR_FAIL;
 }
 
-int HashMapInsert(HashMap *hash_map, Pair *pair) {
-
-  CHECK_ERROR(hash_map && pair, FAIL)
-  if (!HashMapContainsKey(hash_map, pair->key)) {
-    hash_map->size++;
-  }
-  //get load factor and if fails free pair and decrease size
-  double load_factor = HashMapGetLoadFactor(hash_map);
-  if (load_factor == LOAD_FACTOR_FAIL) {
-    hash_map->size--;
-    return FAIL;
+static int GrowFor(HashMap *hash_map, size_t extra) {
+  CHECK_ERROR(extra <= SIZE_MAX - hash_map->size, FAIL)
+  size_t new_capacity = hash_map->capacity;
+  while (LOAD_FACTOR(hash_map->size + extra, new_capacity) >
+      HASH_MAP_MAX_LOAD_FACTOR) {
+    CHECK_ERROR(new_capacity <= MAX_CAPACITY, FAIL)
+    new_capacity *= HASH_MAP_GROWTH_FACTOR;
   }
-  //checks if need new size for buckets
-  int resize_flag = 0;
-  mapCellT *old_buckets = NULL, *new_buckets = NULL;
-  if (load_factor > HASH_MAP_MAX_LOAD_FACTOR) {
-    int new_buckets_success = CreateNewBuckets(hash_map, &new_buckets,
-        hash_map->buckets, hash_map->capacity * HASH_MAP_GROWTH_FACTOR,
-        hash_map->capacity);
-    if (new_buckets_success == FAIL) {
-      hash_map->size--;
-      return FAIL;
-    }
-    hash_map->capacity *= HASH_MAP_GROWTH_FACTOR;
-    old_buckets = hash_map->buckets; // save the original buckets
-    hash_map->buckets = new_buckets;
-    resize_flag = RESIZED;
-  }
-  //inserting new pair
-  size_t index_to_insert_at = (hash_map->hash_func(pair->key)) &
-      (hash_map->capacity - 1);
-  int insert_success = VectorInsert(hash_map, index_to_insert_at, pair);
-  if (insert_success == FAIL) {
-    if (resize_flag) {
-      hash_map->buckets = old_buckets;
-      hash_map->capacity /= HASH_MAP_GROWTH_FACTOR;
-      FreeBuckets(&new_buckets, hash_map->capacity * HASH_MAP_GROWTH_FACTOR);
-    }
-    hash_map->size--;
-    return FAIL;
-  }
-  if (resize_flag) {
-    FreeBuckets(&old_buckets, hash_map->capacity / HASH_MAP_GROWTH_FACTOR);
+  if (new_capacity == hash_map->capacity) {
+    return SUCCESS;
   }
-  return SUCCESS;
+  return Resize(hash_map, new_capacity);
 }
 
-static int VectorInsert(HashMap *hash_map, size_t index_to_insert, Pair
-*pair_to_insert) {
-
-  CHECK_ERROR(hash_map, FAIL)
-  CHECK_ERROR(index_to_insert < hash_map->capacity, FAIL)
-  CHECK_ERROR(pair_to_insert, FAIL)
-  Vector *vec = hash_map->buckets[index_to_insert];
-  if (vec == NULL) {
-    vec = VectorAlloc(hash_map->pair_cpy, hash_map->pair_cmp,
-        hash_map->pair_free);
-    if (!vec) {
-      return FAIL;
-    }
-    hash_map->buckets[index_to_insert] = vec;
-  }
-  for (size_t i = 0; i < vec->size; i++) {
-    Pair *cur_pair = (Pair *) (vec->data[i]);
-    if (cur_pair->key_cmp(cur_pair->key, pair_to_insert->key) == EQUALS) {
-      Pair *new_pair_copy = vec->elem_copy_func((void *) pair_to_insert);
-      if (!new_pair_copy) {
-        return FAIL;
-      }
-      vec->elem_free_func(&vec->data[i]);
-      vec->data[i] = new_pair_copy;
-      return SUCCESS;
+static int Resize(HashMap *hash_map, size_t new_capacity) {
+  size_t old_capacity = hash_map->capacity;
+  CHECK_ERROR(hash_map->ops->resize(hash_map, new_capacity), FAIL)
+  if (hash_map->capacity != old_capacity) {
+    if (hash_map->capacity > old_capacity) {
+      HASH_MAP_COUNT(hash_map, grows, 1);
+    } else {
+      HASH_MAP_COUNT(hash_map, shrinks, 1);
     }
+    HASH_MAP_COUNT(hash_map, rehashed_pairs, hash_map->size);
   }
-  VectorPushBack(vec, (void *) pair_to_insert);
   return SUCCESS;
 }
 
-static void FreeBuckets(mapCellT **p_buckets, size_t arr_size) {
-  for (size_t i = 0; i < arr_size; i++) {
-    if ((*p_buckets)[i] != NULL) {
-      VectorFree(&((*p_buckets)[i]));
-    }
-  }
-  free(*p_buckets);
-  *p_buckets = NULL;
+int HashMapInsert(HashMap *hash_map, Pair *pair) {
+
+  CHECK_ERROR(hash_map && pair, FAIL)
+  return InsertHashed(hash_map, pair, HASH_KEY(hash_map, pair->key), 1);
 }
 
-static int ReHashAll(HashMap *hash_map, mapCellT *dest_buckets, mapCellT
-*src_buckets, size_t dest_size, size_t src_size) {
+int HashMapInsertBatch(HashMap *hash_map, Pair *pairs[], size_t n) {
 
-  for (size_t i = 0; i < src_size; i++) {
-    if (src_buckets[i] == NULL) {
-      continue;
+  CHECK_ERROR(hash_map && (pairs || n == 0), FAIL)
+  for (size_t i = 0; i < n; i++) {
+    CHECK_ERROR(pairs[i], FAIL)
+  }
+  //one resize for the whole batch (pairs with keys in the map count too)
+  CHECK_ERROR(GrowFor(hash_map, n), FAIL)
+  //an incremental map may have put that resize off- then every insert
+  //checks the load factor itself
+  size_t extra = LOAD_FACTOR(hash_map->size + n, hash_map->capacity) >
+      HASH_MAP_MAX_LOAD_FACTOR ? 1 : 0;
+  size_t hashes[BATCH_BLOCK];
+  for (size_t start = 0; start < n; start += BATCH_BLOCK) {
+    size_t block = n - start < BATCH_BLOCK ? n - start : BATCH_BLOCK;
+    for (size_t i = 0; i < block; i++) {
+      hashes[i] = HASH_KEY(hash_map, pairs[start + i]->key);
+      hash_map->ops->prefetch(hash_map, hashes[i]);
     }
-    Vector *cur_vec = src_buckets[i];
-    for (size_t j = 0; j < cur_vec->size; j++) {
-      Pair *cur_pair = (Pair *) cur_vec->data[j];
-      size_t where_to = (hash_map->hash_func(cur_pair->key)) & (dest_size - 1);
-      if (dest_buckets[where_to] == NULL) {
-        Vector *new_vec = VectorAlloc(hash_map->pair_cpy, hash_map->pair_cmp,
-                                      hash_map->pair_free);
-        if (!new_vec) {
-          return FAIL;
-        }
-        dest_buckets[where_to] = new_vec;
-      }
-      int push_success = VectorPushBack(dest_buckets[where_to], cur_pair);
-      if (push_success == FAIL) {
-        return FAIL;
-      }
+    for (size_t i = 0; i < block; i++) {
+      CHECK_ERROR(InsertHashed(hash_map, pairs[start + i], hashes[i],
+                               extra), FAIL)
     }
   }
   return SUCCESS;
 }
 
-static mapCellT *BucketsAlloc(size_t size) {
-  /**
-   * creates new buckets list in size of 'size'
-   */
-  CHECK_ERROR(size != 0, NULL)
-  mapCellT *new_buckets = calloc(size, sizeof(mapCellT));
-  if (!new_buckets) {
-    return NULL;
-  }
-  return new_buckets;
-}
-
-static int CreateNewBuckets(HashMap *hash_map, mapCellT **p_new_buckets,
-    mapCellT *old_buckets, size_t new_buckets_size, size_t old_buckets_size) {
-  /**
-   * creates new dynamiclly allocated buckets array in new size (old_size *
-   * GROWTH_FACTOR) and rehashes all from old buckets to new buckets
-   * if fails rehash frees new allocated array and return FAIL
-   */
-  CHECK_ERROR(hash_map, FAIL)
-  CHECK_ERROR(p_new_buckets, FAIL)
-  CHECK_ERROR((*p_new_buckets) == NULL, FAIL)
-  CHECK_ERROR(old_buckets, FAIL)
-  CHECK_ERROR(new_buckets_size > 0, FAIL)
-  (*p_new_buckets) = BucketsAlloc(new_buckets_size);
-  if (!(*p_new_buckets)) {
-    return FAIL;
+static int InsertHashed(HashMap *hash_map, Pair *pair, size_t hash,
+    size_t extra) {
+  Pair **existing = hash_map->ops->find(hash_map, pair->key, hash);
+  if (existing) {
+    //same key already in map- replace the pair in place
+    Pair *new_pair_copy = HashMapEntryCopy(hash_map, pair);
+    CHECK_ERROR(new_pair_copy, FAIL)
+    if (!ValueIndexAdd(hash_map, pair)) {
+      HashMapEntryFree(hash_map, &new_pair_copy);
+      return FAIL;
+    }
+    ValueIndexRemove(hash_map, (*existing)->value);
+    HashMapEntryFree(hash_map, existing);
+    *existing = new_pair_copy;
+    return SUCCESS;
   }
-
-  int rehash_success = ReHashAll(hash_map, (*p_new_buckets), old_buckets,
-                                 new_buckets_size, old_buckets_size);
-  if (rehash_success == FAIL) {
-    FreeBuckets(p_new_buckets, new_buckets_size);
+  //checks if need new size for buckets
+  CHECK_ERROR(extra == 0 || GrowFor(hash_map, extra), FAIL)
+  //inserting new pair
+  CHECK_ERROR(ValueIndexAdd(hash_map, pair), FAIL)
+  if (!hash_map->ops->insert(hash_map, pair, hash)) {
+    ValueIndexRemove(hash_map, pair->value);
     return FAIL;
   }
+  hash_map->size++;
   return SUCCESS;
 }
 
-static Pair *HashMapGetPairByKey(HashMap *hash_map, KeyT key) {
-  /**
-   * returns a pointer to the pair with the given key or null if not exists
-   */
+ValueT HashMapAt(HashMap *hash_map, KeyT key) {
   CHECK_ERROR(hash_map, NULL)
   CHECK_ERROR(key, NULL)
-  size_t index = (hash_map->hash_func(key)) & (hash_map->capacity - 1);
-  CHECK_ERROR(index < hash_map->capacity, NULL)
-  if (hash_map->buckets[index] == NULL) {
+  Pair **pair = hash_map->ops->find(hash_map, key, HASH_KEY(hash_map, key));
+  if (!pair) {
     return NULL;
   }
-  Vector *vec_to_look_in = hash_map->buckets[index];
-  for (size_t i = 0; i < vec_to_look_in->size; i++) {
-    Pair *to_check = (Pair *) vec_to_look_in->data[i];
-    if (to_check->key_cmp(to_check->key, key)) {
-      return to_check;
-    }
-  }
-  return NULL;
+  return (*pair)->value;
 }
 
-ValueT HashMapAt(HashMap *hash_map, KeyT key) {
-  CHECK_ERROR(hash_map, NULL)
-  CHECK_ERROR(key, NULL)
-  Pair *pair = HashMapGetPairByKey(hash_map, key);
-  if (!pair) {
-    return NULL;
+size_t HashMapAtBatch(HashMap *hash_map, KeyT keys[], size_t n,
+                      ValueT values_out[]) {
+  CHECK_ERROR(hash_map && ((keys && values_out) || n == 0), 0)
+  size_t found = 0;
+  size_t hashes[BATCH_BLOCK];
+  for (size_t start = 0; start < n; start += BATCH_BLOCK) {
+    size_t block = n - start < BATCH_BLOCK ? n - start : BATCH_BLOCK;
+    for (size_t i = 0; i < block; i++) {
+      values_out[start + i] = NULL;
+      if (keys[start + i]) {
+        hashes[i] = HASH_KEY(hash_map, keys[start + i]);
+        hash_map->ops->prefetch(hash_map, hashes[i]);
+      }
+    }
+    for (size_t i = 0; i < block; i++) {
+      if (!keys[start + i]) {
+        continue;
+      }
+      Pair **pair = hash_map->ops->find(hash_map, keys[start + i], hashes[i]);
+      if (pair) {
+        values_out[start + i] = (*pair)->value;
+        found++;
+      }
+    }
   }
-  return pair->value;
+  return found;
 }
 
 int HashMapContainsKey(HashMap *hash_map, KeyT key) {
   CHECK_ERROR(hash_map, FAIL)
   CHECK_ERROR(key, FAIL)
-  if (HashMapGetPairByKey(hash_map, key)) {
+  if (hash_map->ops->find(hash_map, key, HASH_KEY(hash_map, key))) {
     return SUCCESS;
   }
   return FAIL;
@@ -394,16 +489,16 @@ int HashMapContainsValue(HashMap *hash_map, ValueT value) {
 
   CHECK_ERROR(hash_map, FAIL)
   CHECK_ERROR(value, FAIL)
-  for (size_t i = 0; i < hash_map->capacity; i++) {
-    if (hash_map->buckets[i] == NULL) {
-      continue;
-    }
-    Vector *cur_vec = hash_map->buckets[i];
-    for (size_t j = 0; j < cur_vec->size; j++) {
-      Pair *cur_pair = (Pair *) cur_vec->data[j];
-      if (cur_pair->value_cmp(cur_pair->value, value)) {
-        return SUCCESS;
-      }
+  if (hash_map->value_index) {
+    return HashMapContainsKey(hash_map->value_index, value);
+  }
+  size_t bucket = 0, pos = 0;
+  Pair *cur_pair = NULL;
+  while ((cur_pair = hash_map->ops->next(hash_map, &bucket, &pos)) != NULL) {
+    PairValueCmp value_cmp = hash_map->traits ? hash_map->traits->value_cmp
+                                              : cur_pair->value_cmp;
+    if (value_cmp(cur_pair->value, value)) {
+      return SUCCESS;
     }
   }
   return FAIL;
@@ -413,83 +508,302 @@ int HashMapErase(HashMap *hash_map, KeyT key) {
 
   CHECK_ERROR(hash_map, FAIL)
   CHECK_ERROR(key, FAIL)
-  Pair *to_remove = HashMapGetPairByKey(hash_map, key);
-  CHECK_ERROR(to_remove, FAIL)
-
-  hash_map->size--;
-  double load_factor = HashMapGetLoadFactor(hash_map);
-  if (load_factor == LOAD_FACTOR_FAIL) {
-    hash_map->size++;
-    return FAIL;
+  size_t hash = HASH_KEY(hash_map, key);
+  Pair **p_entry = hash_map->ops->find(hash_map, key, hash);
+  CHECK_ERROR(p_entry, FAIL)
+  //the entry itself does not move when the map is resized
+  Pair *entry = *p_entry;
+
+  size_t new_capacity = hash_map->capacity / HASH_MAP_GROWTH_FACTOR;
+  if (hash_map->shrink_policy == HASH_MAP_SHRINK_ON_ERASE &&
+      LOAD_FACTOR(hash_map->size - 1, hash_map->capacity) <
+      hash_map->shrink_load_factor && new_capacity > 0 &&
+      new_capacity >= hash_map->min_capacity) {
+    CHECK_ERROR(Resize(hash_map, new_capacity), FAIL)
   }
-  int resize_flag = 0;
-  mapCellT *old_buckets = NULL, *new_buckets = NULL;
-  if (load_factor < HASH_MAP_MIN_LOAD_FACTOR) {
-    int new_buckets_success = CreateNewBuckets(hash_map, &new_buckets,
-        hash_map->buckets, hash_map->capacity / HASH_MAP_GROWTH_FACTOR,
-        hash_map->capacity);
-    if (new_buckets_success == FAIL) {
-      hash_map->size++;
-      return FAIL;
-    }
-    hash_map->capacity /= HASH_MAP_GROWTH_FACTOR;
-    old_buckets = hash_map->buckets;
-    hash_map->buckets = new_buckets;
-    resize_flag = RESIZED;
-  }
-
-  //deleting new pair
-  size_t vec_index = (hash_map->hash_func(key)) & (hash_map->capacity - 1);
-  Vector *vec_contains_pair = hash_map->buckets[vec_index];
-  int pair_index = VectorFind(vec_contains_pair, to_remove);
-
-  int erase_success = VectorErase(vec_contains_pair, pair_index);
-  if (erase_success == FAIL) {
-    if (resize_flag) {
-      hash_map->buckets = old_buckets;
-      hash_map->capacity *= HASH_MAP_GROWTH_FACTOR;
-      FreeBuckets(&new_buckets, hash_map->capacity / HASH_MAP_GROWTH_FACTOR);
-    }
-    hash_map->size++;
+
+  //deleting the pair
+  ValueIndexRemove(hash_map, entry->value);
+  if (!hash_map->ops->erase(hash_map, key, hash)) {
+    ValueIndexAdd(hash_map, entry);
     return FAIL;
   }
-  if (vec_contains_pair->size == EMPTY_VECTOR) {
-    VectorFree(&vec_contains_pair);
-    hash_map->buckets[vec_index] = NULL;
-  }
-  if (resize_flag) {
-    FreeBuckets(&old_buckets, hash_map->capacity * HASH_MAP_GROWTH_FACTOR);
-  }
+  hash_map->size--;
   return SUCCESS;
 }
 
 void HashMapClear(HashMap *hash_map) {
   CHECK_ERROR(hash_map, NO_RETURN_VALUE)
   size_t size_like = hash_map->size, capacity_like = hash_map->capacity;
-  for (size_t i = 0; i < hash_map->capacity; i++) {
-    if(hash_map->buckets[i] != NULL){
-      UpdateCapacityAndSize(hash_map->buckets[i]->size, &size_like,
-          &capacity_like);
-      VectorFree(&(hash_map->buckets[i]));
-      hash_map->buckets[i] = NULL;
-    }
+  if (hash_map->shrink_policy == HASH_MAP_SHRINK_ON_ERASE) {
+    UpdateCapacityAndSize(hash_map->size, &size_like, &capacity_like,
+                          hash_map->shrink_load_factor);
+  }
+  if (capacity_like < hash_map->min_capacity) {
+    capacity_like = hash_map->min_capacity;
+  }
+  if (capacity_like == 0) {
+    capacity_like = 1;
+  }
+  //the new storage comes first- if it can not be allocated the map keeps
+  //the storage it has
+  void *old_state = hash_map->backend_state;
+  size_t old_capacity = hash_map->capacity;
+  if (capacity_like == hash_map->capacity ||
+      !hash_map->ops->init(hash_map, capacity_like)) {
+    HashMapClearKeepCapacity(hash_map);
+    return;
+  }
+  void *new_state = hash_map->backend_state;
+  size_t new_capacity = hash_map->capacity;
+  hash_map->backend_state = old_state;
+  hash_map->capacity = old_capacity;
+  hash_map->ops->destroy(hash_map);
+  hash_map->backend_state = new_state;
+  hash_map->capacity = new_capacity;
+  hash_map->size = 0;
+  if (hash_map->map_owns_arena) {
+    ArenaReset(hash_map->arena);
+  }
+  HashMapClear(hash_map->value_index);
+  HASH_MAP_COUNT(hash_map, shrinks, 1);
+}
+
+void HashMapClearKeepCapacity(HashMap *hash_map) {
+  CHECK_ERROR(hash_map, NO_RETURN_VALUE)
+  hash_map->ops->clear(hash_map);
+  hash_map->size = 0;
+  if (hash_map->map_owns_arena) {
+    ArenaReset(hash_map->arena);
+  }
+  HashMapClearKeepCapacity(hash_map->value_index);
+}
+
+HashMapIterator HashMapIteratorBegin(HashMap *hash_map) {
+  HashMapIterator iterator = {hash_map, 0, 0, 0, 0, NULL};
+  return iterator;
+}
+
+Pair *HashMapIteratorNext(HashMapIterator *iterator) {
+  CHECK_ERROR(iterator && iterator->hash_map, NULL)
+  HashMap *hash_map = iterator->hash_map;
+  iterator->current_bucket = iterator->bucket;
+  iterator->current_pos = iterator->pos;
+  iterator->current = hash_map->ops->next(hash_map, &iterator->bucket,
+                                          &iterator->pos);
+  return iterator->current;
+}
+
+int HashMapIteratorErase(HashMapIterator *iterator) {
+  CHECK_ERROR(iterator && iterator->hash_map && iterator->current, FAIL)
+  HashMap *hash_map = iterator->hash_map;
+  Pair *entry = iterator->current;
+  KeyT key = entry->key;
+  ValueIndexRemove(hash_map, entry->value);
+  //a migration step of an incremental resize would move pairs across the
+  //cursor- leave both bucket arrays as they are until the walk is over
+  size_t resize_step = hash_map->resize_step;
+  hash_map->resize_step = 0;
+  int erased = hash_map->ops->erase(hash_map, key, HASH_KEY(hash_map, key));
+  hash_map->resize_step = resize_step;
+  if (!erased) {
+    ValueIndexAdd(hash_map, entry);
+    return FAIL;
+  }
+  hash_map->size--;
+  //the pair that took the erased one's place was not visited yet
+  iterator->bucket = iterator->current_bucket;
+  iterator->pos = iterator->current_pos;
+  iterator->current = NULL;
+  return SUCCESS;
+}
+
+Pair *HashMapBucketAt(HashMap *hash_map, size_t index, size_t position) {
+  CHECK_ERROR(hash_map && index < hash_map->capacity, NULL)
+  CHECK_ERROR(hash_map->backend == HASH_MAP_CHAINED ||
+              hash_map->backend == HASH_MAP_CHAINED_INLINE, NULL)
+  //a chained walk stays in a bucket until its pairs run out
+  size_t bucket = index, pos = position;
+  Pair *pair = hash_map->ops->next(hash_map, &bucket, &pos);
+  return bucket == index ? pair : NULL;
+}
+
+int HashMapGetStats(HashMap *hash_map, HashMapStats *stats) {
+  CHECK_ERROR(hash_map && stats, FAIL)
+  memset(stats, 0, sizeof(HashMapStats));
+  stats->size = hash_map->size;
+  stats->capacity = hash_map->capacity;
+  hash_map->ops->stats(hash_map, stats);
+  if (stats->occupied_buckets != 0) {
+    //the sum of the lengths until now
+    stats->average_chain /= (double) stats->occupied_buckets;
+  }
+  stats->counters = hash_map->counters;
+  return SUCCESS;
+}
+
+Pair *HashMapEntryCopy(const HashMap *hash_map, const Pair *pair) {
+  const PairTraits *traits = hash_map->traits;
+  if (!traits) {
+    return hash_map->pair_cpy(pair);
+  }
+  KeyValue *entry = hash_map->arena ?
+      ArenaMalloc(hash_map->arena, sizeof(KeyValue)) :
+      malloc(sizeof(KeyValue));
+  CHECK_ERROR(entry, NULL)
+  entry->key = traits->key_cpy(pair->key);
+  entry->value = traits->value_cpy(pair->value);
+  if (!entry->key || !entry->value) {
+    HashMapEntryFree(hash_map, (Pair **) &entry);
+    return NULL;
   }
-  mapCellT *tmp = realloc(hash_map->buckets, capacity_like * sizeof(mapCellT));
-  if (!tmp) {
+  return (Pair *) entry;
+}
+
+void HashMapEntryFree(const HashMap *hash_map, Pair **p_entry) {
+  const PairTraits *traits = hash_map->traits;
+  if (!traits) {
+    hash_map->pair_free((void **) p_entry);
     return;
-    //this case cannot happen but just in case
   }
-  hash_map->buckets = tmp;
-  hash_map->size = size_like;
-  hash_map->capacity = capacity_like;
+  KeyValue *entry = (KeyValue *) *p_entry;
+  //keys and values the arena owns go when its owner resets it
+  if (entry->key && traits->key_free) {
+    traits->key_free(&entry->key);
+  }
+  if (entry->value && traits->value_free) {
+    traits->value_free(&entry->value);
+  }
+  if (hash_map->arena) {
+    ArenaRelease(hash_map->arena, entry, sizeof(KeyValue));
+  } else {
+    free(entry);
+  }
+  *p_entry = NULL;
+}
+
+void HashMapStatsAddChain(HashMapStats *stats, size_t length) {
+  size_t last = HASH_MAP_STATS_HISTOGRAM - 1;
+  stats->chain_histogram[length < last ? length : last]++;
+  if (length == 0) {
+    return;
+  }
+  stats->occupied_buckets++;
+  stats->average_chain += (double) length;
+  if (length > stats->max_chain) {
+    stats->max_chain = length;
+  }
+}
+
+int HashMapReserve(HashMap *hash_map, size_t num_pairs) {
+  CHECK_ERROR(hash_map, FAIL)
+  if (num_pairs <= hash_map->size) {
+    return SUCCESS;
+  }
+  //an incremental map puts a grow off while an earlier one migrates- the
+  //caller asked for the room now, so finish that migration in this call
+  size_t resize_step = hash_map->resize_step;
+  if (resize_step != 0) {
+    hash_map->resize_step = SIZE_MAX;
+  }
+  int grown = GrowFor(hash_map, num_pairs - hash_map->size);
+  hash_map->resize_step = resize_step;
+  return grown;
+}
+
+int HashMapShrinkToFit(HashMap *hash_map) {
+  CHECK_ERROR(hash_map, FAIL)
+  size_t new_capacity = hash_map->min_capacity ? hash_map->min_capacity : 1;
+  while (LOAD_FACTOR(hash_map->size, new_capacity) >
+      HASH_MAP_MAX_LOAD_FACTOR) {
+    CHECK_ERROR(new_capacity <= MAX_CAPACITY, FAIL)
+    new_capacity *= HASH_MAP_GROWTH_FACTOR;
+  }
+  if (new_capacity >= hash_map->capacity) {
+    return SUCCESS;
+  }
+  return Resize(hash_map, new_capacity);
+}
+
+static void *IndexEntryCpy(const void *entry) {
+  return PairCopy((const Pair *) entry);
+}
+
+static int IndexEntryCmp(const void *entry_1, const void *entry_2) {
+  const Pair *pair_1 = entry_1, *pair_2 = entry_2;
+  return pair_1->key_cmp(pair_1->key, pair_2->key) &&
+      pair_1->value == pair_2->value;
+}
+
+static void IndexEntryFree(void **p_entry) {
+  PairFree((Pair **) p_entry);
+}
+
+static ValueT CountKeep(ValueT count) {
+  return count;
+}
+
+static int CountSame(ValueT count_1, ValueT count_2) {
+  return count_1 == count_2;
+}
+
+static void CountForget(ValueT *p_count) {
+  *p_count = NULL;
+}
+
+static int ValueIndexAdd(HashMap *hash_map, const Pair *pair) {
+  HashMap *index = hash_map->value_index;
+  CHECK_ERROR(index, SUCCESS)
+  size_t hash = HASH_KEY(index, pair->value);
+  Pair **entry = index->ops->find(index, pair->value, hash);
+  if (entry) {
+    (*entry)->value = COUNT_TO_VALUE(VALUE_TO_COUNT((*entry)->value) + 1);
+    return SUCCESS;
+  }
+  //the index keeps its own copy of the value, with the value functions of
+  //the map's traits or of the pair
+  const PairTraits *traits = hash_map->traits;
+  Pair new_entry = {
+      pair->value, COUNT_TO_VALUE(1),
+      traits ? traits->value_cpy : pair->value_cpy, CountKeep,
+      traits ? traits->value_cmp : pair->value_cmp, CountSame,
+      traits ? traits->value_free : pair->value_free, CountForget
+  };
+  return InsertHashed(index, &new_entry, hash, 1);
+}
+
+static void ValueIndexRemove(HashMap *hash_map, ValueT value) {
+  HashMap *index = hash_map->value_index;
+  CHECK_ERROR(index, NO_RETURN_VALUE)
+  size_t hash = HASH_KEY(index, value);
+  Pair **entry = index->ops->find(index, value, hash);
+  CHECK_ERROR(entry, NO_RETURN_VALUE)
+  size_t count = VALUE_TO_COUNT((*entry)->value);
+  if (count > 1) {
+    (*entry)->value = COUNT_TO_VALUE(count - 1);
+    return;
+  }
+  //the backend erase never resizes the index (it only shrinks when the map
+  //is cleared), so a value can not stay counted after its last pair
+  if (index->ops->erase(index, value, hash)) {
+    index->size--;
+  }
+}
+
+static size_t RoundUpPowerOf2(size_t num) {
+  size_t power = 1;
+  while (power < num) {
+    power *= 2;
+  }
+  return power;
 }
 
 static void UpdateCapacityAndSize(size_t vector_size, size_t *p_map_size,size_t
-*p_map_capacity) {
+*p_map_capacity, double shrink_load_factor) {
   for(size_t i = 0; i < vector_size; i++){
     (*p_map_size)--;
     if(LOAD_FACTOR((*p_map_size), (*p_map_capacity)) <
-    HASH_MAP_MIN_LOAD_FACTOR){
+    shrink_load_factor){
       (*p_map_capacity) /= HASH_MAP_GROWTH_FACTOR;
     }
   }
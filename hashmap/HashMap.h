@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include "Vector.h"
 #include "Pair.h"
+#include "Arena.h"
 
 /**
  * @def HASH_MAP_INITIAL_CAP
@@ -41,6 +42,13 @@
  */
 #define HASH_MAP_MAX_LOAD_FACTOR 0.75
 
+/**
+ * @def HASH_MAP_STATS_HISTOGRAM
+ * The number of entries in HashMapStats.chain_histogram: chains of length
+ * 0, 1, ... and the last one for every longer chain.
+ */
+#define HASH_MAP_STATS_HISTOGRAM 8
+
 /**
  * @typedef HashFunc
  * This type of function receives a KeyT and returns
@@ -51,6 +59,13 @@
  */
 typedef size_t (*HashFunc)(KeyT);
 
+/**
+ * @typedef SeededHashFunc
+ * A HashFunc that also receives a seed, different seeds give unrelated
+ * hashes for the same key (see the Seeded functions of Hash.h).
+ */
+typedef size_t (*SeededHashFunc)(KeyT, size_t);
+
 /**
  * @typedef HashMapPairCpy
  * A copy function for the pairs stored in the vectors (which are stored in the hash map).
@@ -69,26 +84,256 @@ typedef int (*HashMapPairCmp)(const void *, const void *);
  */
 typedef void (*HashMapPairFree)(void **);
 
+/**
+ * @enum HashMapBackend
+ * The storage engine of a hash map, chosen once at allocation time.
+ * HASH_MAP_CHAINED - every bucket is a vector of pairs (the default).
+ * HASH_MAP_ROBIN_HOOD - a flat open addressing table of (hash, pair) slots,
+ * using Robin Hood insertion and backward shift deletion, so a lookup reads
+ * one contiguous run of slots instead of chasing bucket -> vector -> pair.
+ * HASH_MAP_SWISS - open addressing with a 1 byte control array (7 bits of
+ * the hash per slot) probed 16 slots at a time, so most misses are decided
+ * by the control bytes alone, without calling key_cmp.
+ * HASH_MAP_DENSE - the pairs are kept in one dense array of (hash, pair)
+ * entries and the table only holds indices into it, so walking the map
+ * (HashMapIterator, HashMapContainsValue, HashMapClear) streams through the
+ * entries without touching empty slots.
+ * HASH_MAP_CHAINED_INLINE - chained buckets that keep their first
+ * HASH_MAP_INLINE_PAIRS pairs in the bucket array and only allocate an
+ * overflow of (hash, pair) slots for the pairs after them, so most buckets
+ * allocate nothing and a lookup skips the pointer to the bucket.
+ */
+typedef enum HashMapBackend {
+  HASH_MAP_CHAINED,
+  HASH_MAP_ROBIN_HOOD,
+  HASH_MAP_SWISS,
+  HASH_MAP_DENSE,
+  HASH_MAP_CHAINED_INLINE,
+} HashMapBackend;
+
+/**
+ * @enum HashMapShrinkPolicy
+ * When a hash map gives memory back.
+ * HASH_MAP_SHRINK_ON_ERASE - HashMapErase halves the capacity when the load
+ * factor drops below the shrink load factor, HashMapClear shrinks the map as
+ * if its pairs were erased one by one (the default).
+ * HASH_MAP_SHRINK_MANUAL - erasing and clearing never shrink the map, only
+ * HashMapShrinkToFit does, so a map that is emptied and refilled again and
+ * again is not rehashed on every cycle.
+ */
+typedef enum HashMapShrinkPolicy {
+  HASH_MAP_SHRINK_ON_ERASE,
+  HASH_MAP_SHRINK_MANUAL,
+} HashMapShrinkPolicy;
+
+/**
+ * @struct HashMapOptions
+ * Optional settings for HashMapAllocWithOptions.
+ * A zero initialized struct gives the same map as HashMapAlloc.
+ * @param backend the storage engine of the map.
+ * @param traits the key and value functions of all the pairs, NULL to use
+ * pair_cpy, pair_cmp, pair_free and the functions of every stored pair.
+ * With traits the map keeps them once and stores every pair as a KeyValue
+ * (16 bytes instead of sizeof(Pair)); the pair_* functions may be NULL, and
+ * of a pair given to HashMapInsert only the key and the value are read.
+ * The traits must outlive the map.
+ * @param seeded_hash hashes the keys instead of hash_func (which may then be
+ * NULL), with the map's seed. NULL to use hash_func.
+ * @param seed the seed of seeded_hash, 0 to draw a random seed for the map
+ * (so keys chosen to collide in one run do not collide in the next).
+ * @param incremental_resize_step 0 rehashes the whole map inside the insert
+ * (or erase) that crossed the load factor. A positive value keeps the old
+ * and the new bucket arrays alive and moves this many old buckets to the new
+ * array on every following insert, lookup and erase, so no single
+ * operation pays for the whole map (HASH_MAP_CHAINED only). A resize that
+ * comes due while the previous one is still migrating waits until it is
+ * done (the map stays in its capacity a few operations longer, and so may
+ * HashMapShrinkToFit); HashMapReserve finishes that migration and grows
+ * right away. Since lookups move buckets too,
+ * HashMapAt, HashMapContainsKey and the other lookups change the map in
+ * this mode: they are not read-only, and must not run at the same time as
+ * any other operation on the map.
+ * @param initial_pairs number of pairs the new map holds without growing,
+ * 0 for a map of HASH_MAP_INITIAL_CAP. The allocation fails if no capacity
+ * (whose slot array size fits in a size_t) holds that many pairs.
+ * @param min_capacity the map never shrinks below this capacity (rounded up
+ * to a power of 2), 0 for no limit.
+ * @param shrink_policy when the map shrinks.
+ * @param shrink_load_factor HASH_MAP_SHRINK_ON_ERASE shrinks below this load
+ * factor, 0 for HASH_MAP_MIN_LOAD_FACTOR. Must be below
+ * HASH_MAP_MAX_LOAD_FACTOR / HASH_MAP_GROWTH_FACTOR (so a shrunk map does
+ * not have to grow right away); a lower value keeps a wider gap between
+ * growing and shrinking.
+ * @param value_hash hashes values (values equal by value_cmp must get the
+ * same hash), and gives the map a value index: a copy of every distinct
+ * value and the number of pairs holding it, so HashMapContainsValue takes
+ * expected O(1) instead of a walk over the whole map. Costs a lookup in the
+ * index on every insert and erase. NULL for no index.
+ * @param arena the arena the map allocates its entries (KeyValue) from,
+ * NULL to use malloc. Needs traits. The map gives every entry back to the
+ * arena when the pair is erased, and never resets or frees the arena: its
+ * owner does, after the map (and any copy of it) is freed. Not thread safe.
+ * @param arena_owns_keys 1 if the keys and values live in the arena too,
+ * owned by it instead of by the map: the traits have no key_free and
+ * value_free, and the map frees only the entries. key_cpy and value_cpy get
+ * no allocator argument, so they reach the arena through a global (see
+ * Arena.h). Needs arena. 0 for keys and values freed with the traits.
+ * @param map_owns_arena 1 hands the arena over to the map: nothing but the
+ * map allocates from it, and the map frees it in HashMapFree. Since the
+ * arena then holds everything the pairs own (needs arena_owns_keys), and a
+ * chained map keeps its buckets there too, HashMapFree, HashMapClear and
+ * HashMapClearKeepCapacity release the pairs all at once by freeing or
+ * resetting the arena instead of visiting every pair. Such a map can not be
+ * copied (HashMapCopy). 0 for an arena shared with its owner, who resets
+ * and frees it.
+ */
+typedef struct HashMapOptions {
+  HashMapBackend backend;
+  const PairTraits *traits;
+  SeededHashFunc seeded_hash;
+  size_t seed;
+  size_t incremental_resize_step;
+  size_t initial_pairs;
+  size_t min_capacity;
+  HashMapShrinkPolicy shrink_policy;
+  double shrink_load_factor;
+  HashFunc value_hash;
+  Arena *arena;
+  int arena_owns_keys;
+  int map_owns_arena;
+} HashMapOptions;
+
+/**
+ * @def HASH_MAP_INLINE_PAIRS
+ * The number of pairs a HASH_MAP_CHAINED_INLINE bucket keeps inline.
+ */
+#define HASH_MAP_INLINE_PAIRS 2
+
+/**
+ * @struct HashMapCounters
+ * What a map counts while it works. Every map has the counters, they only
+ * count if built with HASH_MAP_STATS (otherwise they stay 0).
+ * @param grows, shrinks the number of resizes to a bigger or a smaller
+ * capacity.
+ * @param rehashed_pairs the number of pairs the resizes moved (an
+ * incremental resize counts its pairs when it starts).
+ * @param key_cmps the number of key_cmp calls.
+ */
+typedef struct HashMapCounters {
+  size_t grows;
+  size_t shrinks;
+  size_t rehashed_pairs;
+  size_t key_cmps;
+} HashMapCounters;
+
+/**
+ * @struct HashMapStats
+ * A report on a map, filled by HashMapGetStats.
+ * A chain is a bucket of the chained backends (its length is its number of
+ * pairs), and a slot of the open addressing backends (its length is the
+ * number of slots, or groups for HASH_MAP_SWISS, a lookup probes to find its
+ * pair, 0 if it is empty).
+ * @param size the number of pairs.
+ * @param capacity the number of buckets (or slots).
+ * @param occupied_buckets the number of chains that are not empty.
+ * @param max_chain the length of the longest chain.
+ * @param average_chain the average length of the chains that are not empty.
+ * @param chain_histogram the number of chains of length 0, 1, ..., the last
+ * entry counts every chain of HASH_MAP_STATS_HISTOGRAM - 1 or more.
+ * @param counters what the map counted since it was allocated, all 0 unless
+ * built with HASH_MAP_STATS.
+ */
+typedef struct HashMapStats {
+  size_t size;
+  size_t capacity;
+  size_t occupied_buckets;
+  size_t max_chain;
+  double average_chain;
+  size_t chain_histogram[HASH_MAP_STATS_HISTOGRAM];
+  HashMapCounters counters;
+} HashMapStats;
+
+struct HashMapBackendOps;
+
 /**
  * @struct HashMap
- * @param buckets dynamic array of vectors which stores the values.
  * @param size the number of elements (pairs) stored in the hash map.
  * @param capacity the number of buckets in the hash map.
  * @param hash_func a function which "hashes" keys.
  * @param pair_cpy a function which copies pairs.
  * @param pair_cmp a function which compares pairs.
  * @param pair_free a function which frees pairs.
+ * @param backend the storage engine of the map.
+ * @param ops the operations of the storage engine (internal).
+ * @param backend_state the storage of the pairs, allocated by ops->init and
+ * freed by ops->destroy. Its layout is private to the storage engine
+ * (internal).
+ * @param traits the key and value functions of all pairs, NULL if every
+ * stored pair carries its own functions.
+ * @param resize_step number of old buckets moved on every operation, 0 for
+ * stop-the-world resizing.
+ * @param seeded_hash hashes the keys with seed instead of hash_func, NULL to
+ * use hash_func.
+ * @param seed the seed of seeded_hash.
+ * @param min_capacity the map never shrinks below this capacity.
+ * @param shrink_policy when the map shrinks.
+ * @param shrink_load_factor the load factor HASH_MAP_SHRINK_ON_ERASE shrinks
+ * below.
+ * @param value_hash hashes the values for the value index.
+ * @param value_index maps every value held by a pair to the number of pairs
+ * holding it, NULL if the map has no value_hash.
+ * @param arena the arena the entries are allocated from, NULL for malloc.
+ * @param arena_owns_keys 1 if the keys and values live in the arena, and
+ * are not freed by the map.
+ * @param map_owns_arena 1 if the arena belongs to the map alone: the map
+ * resets it to drop all of its pairs at once, and frees it.
+ * @param counters resizes and key_cmp calls so far (always 0 unless built
+ * with HASH_MAP_STATS- the field is there either way, so code built with
+ * and without it agrees on the layout of HashMap).
  */
 typedef struct HashMap {
-  Vector **buckets;
   size_t size;
   size_t capacity; // num of buckets.
   HashFunc hash_func;
   HashMapPairCpy pair_cpy;
   HashMapPairCmp pair_cmp;
   HashMapPairFree pair_free;
+  HashMapBackend backend;
+  const struct HashMapBackendOps *ops;
+  void *backend_state;
+  const PairTraits *traits;
+  size_t resize_step;
+  SeededHashFunc seeded_hash;
+  size_t seed;
+  size_t min_capacity;
+  HashMapShrinkPolicy shrink_policy;
+  double shrink_load_factor;
+  HashFunc value_hash;
+  struct HashMap *value_index;
+  Arena *arena;
+  int arena_owns_keys;
+  int map_owns_arena;
+  HashMapCounters counters;
 } HashMap;
 
+/**
+ * @struct HashMapIterator
+ * A cursor walking the pairs of a hash map (see HashMapIteratorBegin).
+ * @param hash_map the map being walked.
+ * @param bucket, pos the cursor of the next pair.
+ * @param current_bucket, current_pos the cursor of the pair returned last.
+ * @param current the pair returned last, NULL if there is none (or it was
+ * erased).
+ */
+typedef struct HashMapIterator {
+  HashMap *hash_map;
+  size_t bucket;
+  size_t pos;
+  size_t current_bucket;
+  size_t current_pos;
+  Pair *current;
+} HashMapIterator;
+
 /**
  * Allocates dynamically new hash map element.
  * @param hash_func a function which "hashes" keys.
@@ -102,12 +347,53 @@ HashMap *HashMapAlloc(
     HashFunc hash_func, HashMapPairCpy pair_cpy,
     HashMapPairCmp pair_cmp, HashMapPairFree pair_free);//done
 
+/**
+ * Allocates dynamically new hash map element with the given options.
+ * @param hash_func a function which "hashes" keys (may be NULL if the
+ * options give a seeded_hash).
+ * @param pair_cpy a function which copies pairs.
+ * @param pair_cmp a function which compares pairs.
+ * @param pair_free a function which frees pairs.
+ * @param options the map's settings, NULL for the defaults.
+ * @return pointer to dynamically allocated HashMap.
+ * @if_fail return NULL (an arena of map_owns_arena stays the caller's).
+ */
+HashMap *HashMapAllocWithOptions(
+    HashFunc hash_func, HashMapPairCpy pair_cpy,
+    HashMapPairCmp pair_cmp, HashMapPairFree pair_free,
+    const HashMapOptions *options);
+
+/**
+ * Allocates dynamically new hash map element big enough for the given
+ * number of pairs (no resize happens until it holds more of them).
+ * @param hash_func a function which "hashes" keys.
+ * @param pair_cpy a function which copies pairs.
+ * @param pair_cmp a function which compares pairs.
+ * @param pair_free a function which frees pairs.
+ * @param num_pairs the number of pairs the map should hold without growing.
+ * @return pointer to dynamically allocated HashMap.
+ * @if_fail return NULL.
+ */
+HashMap *HashMapAllocWithCapacity(
+    HashFunc hash_func, HashMapPairCpy pair_cpy,
+    HashMapPairCmp pair_cmp, HashMapPairFree pair_free, size_t num_pairs);
+
 /**
  * Frees a vector and the elements the vector itself allocated.
  * @param p_hash_map pointer to dynamically allocated pointer to hash_map.
  */
 void HashMapFree(HashMap **p_hash_map);//done
 
+/**
+ * Allocates a copy of the hash map: the same functions and settings, and a
+ * copy of every pair (made like HashMapInsert makes them).
+ * @param hash_map the hash map to copy (not changed).
+ * @return pointer to dynamically allocated HashMap.
+ * @if_fail return NULL (always for a map with map_owns_arena, whose arena
+ * can not be shared).
+ */
+HashMap *HashMapCopy(HashMap *hash_map);
+
 /**
  * Inserts a new pair to the hash map.
  * The function inserts *new*, *copied*, *dynamically allocated* pair,
@@ -118,6 +404,22 @@ void HashMapFree(HashMap **p_hash_map);//done
  */
 int HashMapInsert(HashMap *hash_map, Pair *pair);
 
+/**
+ * Inserts n pairs, like calling HashMapInsert on each of them in order.
+ * Makes room for all of them with a single resize (so a batch with keys
+ * already in the map may leave it bigger than HashMapInsert would; an
+ * incremental map that puts that resize off grows pair by pair instead), then
+ * hashes the keys of every few pairs and prefetches their places before
+ * inserting them, so the cache misses of the pairs overlap.
+ * @param hash_map the hash map to be inserted with the new elements.
+ * @param pairs the pairs the hash map would contain (copied, like in
+ * HashMapInsert).
+ * @param n number of pairs.
+ * @return returns 1 if all the pairs were inserted, 0 otherwise (the pairs
+ * before the failing one stay in the map).
+ */
+int HashMapInsertBatch(HashMap *hash_map, Pair *pairs[], size_t n);
+
 /**
  * The function checks if the given key exists in the hash map.
  * @param hash_map a hash map.
@@ -128,6 +430,8 @@ int HashMapContainsKey(HashMap *hash_map, KeyT key);//done- check
 
 /**
  * The function checks if the given value exists in the hash map.
+ * Expected O(1) if the map has a value index (HashMapOptions.value_hash),
+ * otherwise walks all the pairs.
  * @param hash_map a hash map.
  * @param value the value to be checked.
  * @return 1 if the value is in the hash map, 0 otherwise.
@@ -142,6 +446,20 @@ int HashMapContainsValue(HashMap *hash_map, ValueT value);// done- check
  */
 ValueT HashMapAt(HashMap *hash_map, KeyT key);//done- check
 
+/**
+ * Looks up n keys, like calling HashMapAt on each of them, but hashes every
+ * few keys and prefetches their places before looking them up, so the cache
+ * misses of the keys overlap.
+ * @param hash_map a hash map.
+ * @param keys the keys to be checked.
+ * @param n number of keys.
+ * @param values_out output - values_out[i] is the value associated with
+ * keys[i], NULL if keys[i] is not in the map.
+ * @return the number of keys found in the map.
+ */
+size_t HashMapAtBatch(HashMap *hash_map, KeyT keys[], size_t n,
+                      ValueT values_out[]);
+
 /**
  * The function erases the pair associated with key.
  * @param hash_map a hash map.
@@ -158,9 +476,104 @@ int HashMapErase(HashMap *hash_map, KeyT key);
 double HashMapGetLoadFactor(HashMap *hash_map);// done- check
 
 /**
- * This function deletes all the elements in the hash map.
+ * Grows the hash map (with at most one rehash) so it holds num_pairs pairs
+ * without growing again. A map with incremental_resize_step that is still
+ * migrating an earlier resize finishes that migration first (this call moves
+ * all of its remaining old buckets).
+ * @param hash_map a hash map.
+ * @param num_pairs the number of pairs the map should hold.
+ * @return 1 upon success (also if the map is already big enough), 0
+ * otherwise (also if no capacity holds num_pairs pairs- the map is left as
+ * it was).
+ */
+int HashMapReserve(HashMap *hash_map, size_t num_pairs);
+
+/**
+ * Shrinks the hash map to the smallest capacity (not below its
+ * min_capacity) that holds its pairs within HASH_MAP_MAX_LOAD_FACTOR.
+ * @param hash_map a hash map.
+ * @return 1 upon success, 0 otherwise.
+ */
+int HashMapShrinkToFit(HashMap *hash_map);
+
+/**
+ * This function deletes all the elements in the hash map. If the smaller
+ * storage can not be allocated the map keeps its capacity (like
+ * HashMapClearKeepCapacity).
  * @param hash_map a hash map to be cleared.
  */
 void HashMapClear(HashMap *hash_map);
 
+/**
+ * Deletes all the elements in the hash map but keeps its capacity (unlike
+ * HashMapClear, whatever the shrink policy), so a scratch map that is
+ * emptied and refilled again and again is never reallocated or rehashed.
+ * The storage is emptied in place; a chained map keeps the memory of its
+ * buckets as well (unless the buckets live in the arena of a map with
+ * map_owns_arena, which is reset in one go).
+ * @param hash_map a hash map to be cleared.
+ */
+void HashMapClearKeepCapacity(HashMap *hash_map);
+
+/**
+ * Starts walking all the pairs of the hash map, in no particular order
+ * (insertion order for HASH_MAP_DENSE as long as nothing is erased).
+ * Example:
+ *   HashMapIterator iterator = HashMapIteratorBegin(hash_map);
+ *   Pair *pair = NULL;
+ *   while ((pair = HashMapIteratorNext(&iterator)) != NULL) { ... }
+ * The map may not be changed during the walk, except with
+ * HashMapIteratorErase.
+ * @param hash_map a hash map.
+ * @return an iterator before the first pair.
+ */
+HashMapIterator HashMapIteratorBegin(HashMap *hash_map);
+
+/**
+ * Returns the next pair of the walk. Only its key and value may be read
+ * (the map keeps a KeyValue if it has traits), and the value may be changed
+ * in place.
+ * @param iterator an iterator made by HashMapIteratorBegin.
+ * @return the next pair, NULL when every pair was visited.
+ */
+Pair *HashMapIteratorNext(HashMapIterator *iterator);
+
+/**
+ * Erases the pair HashMapIteratorNext returned last; the walk goes on with
+ * the pair after it. The map does not shrink during the walk (call
+ * HashMapShrinkToFit after it if needed).
+ * @param iterator an iterator made by HashMapIteratorBegin.
+ * @return 1 if the pair was erased, 0 otherwise.
+ */
+int HashMapIteratorErase(HashMapIterator *iterator);
+
+/**
+ * Returns a pair of one bucket of a chained map (HASH_MAP_CHAINED or
+ * HASH_MAP_CHAINED_INLINE). The buckets are private to the storage engine
+ * (HashMap has no buckets field any more); this reads what
+ * hash_map->buckets[index]->data[position] used to. The pair with key k is
+ * in bucket hash_func(k) & (capacity - 1), unless an incremental resize has
+ * not moved it out of the old buckets yet (those are not reachable here).
+ * Only its key and value may be read (see HashMapIteratorNext).
+ * @param hash_map a chained hash map.
+ * @param index the bucket, less than capacity.
+ * @param position the position of the pair in the bucket, from 0.
+ * @return the pair, NULL if the bucket holds no more than position pairs or
+ * the map is not chained.
+ */
+Pair *HashMapBucketAt(HashMap *hash_map, size_t index, size_t position);
+
+/**
+ * Reports the shape of the map: how long its chains are (degenerate hashing
+ * shows as long chains and a histogram far from the load factor's), and
+ * how many resizes, rehashed pairs and key_cmp calls it took so far.
+ * The chains are measured by walking the whole map. The counters are only
+ * counted where the library is built with -DHASH_MAP_STATS (the counting
+ * then costs an atomic add per key_cmp call; without it, it costs nothing).
+ * @param hash_map a hash map.
+ * @param stats output.
+ * @return 1 upon success, 0 otherwise.
+ */
+int HashMapGetStats(HashMap *hash_map, HashMapStats *stats);
+
 #endif //HASHMAP_H_
@@ -0,0 +1,221 @@
+/**
+ * @file HashMapBackend.h
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief internal interface between HashMap.c and the storage engines
+ * (backends) of the hash map. Not part of the public API.
+ *
+ * HashMap.c owns the policy (hashing, load factor, copying pairs), every
+ * backend owns only the layout of the pairs in memory.
+ */
+
+#ifndef HASHMAPBACKEND_H_
+#define HASHMAPBACKEND_H_
+
+#include "HashMap.h"
+
+// -------------------------- const definitions -------------------------
+/**
+ * @def NO_RETURN_VALUE
+ * @brief return value used in void functions for the CHECK_ERROR constant
+ */
+#define NO_RETURN_VALUE ((void)(0))
+
+/**
+ * @def CHECK_ERROR
+ * @brief constant reecives a boolean expression and checks if it is true- if
+ * not return the retern value ret_val
+ */
+#define CHECK_ERROR(expression, ret_val) if(!(expression)){\
+return ret_val;\
+}
+
+/**
+ * @def SUCCESS
+ * @brief return value for int type functions in case of succession
+ */
+#define SUCCESS 1
+
+/**
+ * @def FAIL
+ * @brief return value for int type functions in case of failure
+ */
+#define FAIL 0
+
+/**
+ * @def EQUALS
+ * @brief return value for compare functions in case the items are equal
+ */
+#define EQUALS 1
+
+/**
+ * @def HASH_MAP_COUNT
+ * @brief adds n to a counter of the map (see HashMapCounters), nothing
+ * unless built with HASH_MAP_STATS (the counters are in every map, only the
+ * counting is compiled out). Lookups count as well, and a map may be
+ * read by many threads at once (ConcurrentHashMap, SnapshotHashMap), so the
+ * counters are added to with relaxed atomics
+ */
+#ifndef HASH_MAP_STATS
+#define HASH_MAP_COUNT(hash_map, counter, n) ((void) 0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define HASH_MAP_COUNT(hash_map, counter, n) \
+    ((void) __atomic_fetch_add(&(hash_map)->counters.counter, (n), \
+                               __ATOMIC_RELAXED))
+#else
+#define HASH_MAP_COUNT(hash_map, counter, n) \
+    ((void) ((hash_map)->counters.counter += (n)))
+#endif
+
+/**
+ * @struct HashMapSlot
+ * A pair and the full hash of its key, as most backends store them.
+ * @param hash the full hash of the pair's key.
+ * @param pair the pair (a KeyValue if the map has traits), NULL if the slot
+ * is empty.
+ */
+typedef struct HashMapSlot {
+  size_t hash;
+  Pair *pair;
+} HashMapSlot;
+
+/**
+ * @def ENTRY_HAS_KEY
+ * @brief checks if the stored pair has the given key, with the map's traits
+ * if it has them, otherwise with the pair's own key_cmp
+ */
+#define ENTRY_HAS_KEY(hash_map, entry, key) \
+    (HASH_MAP_COUNT(hash_map, key_cmps, 1), (hash_map)->traits ? \
+    (hash_map)->traits->key_cmp((entry)->key, (key)) : \
+    (entry)->key_cmp((entry)->key, (key)))
+
+/**
+ * @def HASH_KEY
+ * @brief hashes a key with the map's seeded hash if it has one, otherwise
+ * with its hash_func
+ */
+#define HASH_KEY(hash_map, key) ((hash_map)->seeded_hash ? \
+    (hash_map)->seeded_hash((key), (hash_map)->seed) : \
+    (hash_map)->hash_func(key))
+
+/**
+ * @def ENTRIES_IN_ARENA
+ * @brief checks if everything the pairs of the map own lives in an arena the
+ * map owns (map_owns_arena), so destroy and clear drop the pairs without
+ * visiting them- the map resets or frees the arena right after
+ */
+#define ENTRIES_IN_ARENA(hash_map) ((hash_map)->map_owns_arena)
+
+/**
+ * @def HASH_MAP_PREFETCH
+ * @brief hints the cpu to start loading the cache line of addr (a no-op if
+ * the compiler has no prefetch builtin)
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define HASH_MAP_PREFETCH(addr) __builtin_prefetch((addr))
+#else
+#define HASH_MAP_PREFETCH(addr) ((void) (addr))
+#endif
+
+// ------------------------------ backend api ---------------------------
+
+/**
+ * @struct HashMapBackendOps
+ * The operations every storage engine implements.
+ * @param init allocates the backend's state (hash_map->backend_state, whose
+ * layout only the backend knows) with empty storage in the given capacity
+ * and sets hash_map->capacity. returns 1 upon success, 0 otherwise (leaving
+ * the map untouched, so a map can allocate new storage before it destroys
+ * the old one).
+ * @param destroy frees every pair (unless ENTRIES_IN_ARENA), the storage and
+ * the state, and sets backend_state to NULL.
+ * @param find returns a pointer to the place the pair with the given key is
+ * kept in (so it can be replaced), NULL if the key is not in the map.
+ * @param insert inserts a copy (made with HashMapEntryCopy) of a pair whose
+ * key is not in the map. returns 1 upon success, 0 otherwise.
+ * @param erase removes and frees the pair with the given key.
+ * returns 1 upon success, 0 otherwise.
+ * @param resize moves every pair to new storage in the given capacity and
+ * sets hash_map->capacity. on failure the map is left untouched. An
+ * incremental chained map may put a resize off (succeeding, with the
+ * capacity unchanged) while the previous one is still migrating, unless
+ * resize_step is large enough to finish that migration (HashMapReserve sets
+ * it to SIZE_MAX for the call).
+ * @param next returns the first pair at or after the cursor (bucket, pos)
+ * and moves the cursor past it, NULL when there are no more pairs. The walk
+ * starts at (0, 0). After erasing the pair it just returned (with no
+ * migration step) the walk may go on from the cursor it had before that
+ * call, and still visits every other pair exactly once.
+ * @param prefetch starts loading the memory a find of the given hash reads
+ * first, so batched operations overlap their cache misses.
+ * @param clear frees every pair (unless ENTRIES_IN_ARENA) and empties the
+ * storage in place, keeping its capacity (and, if it can, the memory the
+ * next pairs will need).
+ * @param stats passes the length of every chain (see HashMapStats) to
+ * HashMapStatsAddChain.
+ */
+typedef struct HashMapBackendOps {
+  int (*init)(HashMap *hash_map, size_t capacity);
+  void (*destroy)(HashMap *hash_map);
+  Pair **(*find)(HashMap *hash_map, KeyT key, size_t hash);
+  int (*insert)(HashMap *hash_map, Pair *pair, size_t hash);
+  int (*erase)(HashMap *hash_map, KeyT key, size_t hash);
+  int (*resize)(HashMap *hash_map, size_t new_capacity);
+  Pair *(*next)(HashMap *hash_map, size_t *bucket, size_t *pos);
+  void (*prefetch)(const HashMap *hash_map, size_t hash);
+  void (*clear)(HashMap *hash_map);
+  void (*stats)(const HashMap *hash_map, HashMapStats *stats);
+} HashMapBackendOps;
+
+/**
+ * Copies a pair into the form the map stores: a KeyValue copied with the
+ * map's traits, or a Pair copied with pair_cpy.
+ * @param hash_map the map the copy is for
+ * @param pair the pair to copy
+ * @return the copy (typed Pair * in both cases, only key and value may be
+ * read from a KeyValue), NULL if failed
+ */
+Pair *HashMapEntryCopy(const HashMap *hash_map, const Pair *pair);
+
+/**
+ * Frees a pair stored in the map (made by HashMapEntryCopy).
+ * @param hash_map the map holding the pair
+ * @param p_entry pointer to the stored pair, set to NULL
+ */
+void HashMapEntryFree(const HashMap *hash_map, Pair **p_entry);
+
+/**
+ * Adds a chain to the histogram, the longest chain and the occupied buckets
+ * of a report (HashMapGetStats turns the sum of the lengths, kept in
+ * average_chain meanwhile, into the average).
+ * @param stats the report being filled
+ * @param length the length of the chain
+ */
+void HashMapStatsAddChain(HashMapStats *stats, size_t length);
+
+/**
+ * a growing array of (hash, pair) slots in every bucket (ChainedBackend.c)
+ */
+extern const HashMapBackendOps ChainedBackendOps;
+
+/**
+ * Robin Hood open addressing (RobinHoodBackend.c)
+ */
+extern const HashMapBackendOps RobinHoodBackendOps;
+
+/**
+ * control byte group probing (SwissBackend.c)
+ */
+extern const HashMapBackendOps SwissBackendOps;
+
+/**
+ * dense entries array and a table of indices (DenseBackend.c)
+ */
+extern const HashMapBackendOps DenseBackendOps;
+
+/**
+ * chained buckets with their first pairs inline (ChainedInlineBackend.c)
+ */
+extern const HashMapBackendOps ChainedInlineBackendOps;
+
+#endif //HASHMAPBACKEND_H_
@@ -0,0 +1,636 @@
+/**
+ * @file Hashmap_bench.c
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief benchmarks of HashMap (every backend) and Vector, for comparing a
+ * change against the tree before it.
+ *
+ * Usage: Hashmap_bench [max_n [identity]]
+ * runs every operation at n = 10^3, 10^4, ... up to max_n (default 10^6, at
+ * most 10^8) elements, for every key distribution:
+ * sequential - 0, 1, 2, ...
+ * random - a bijective mix of the index, so no key repeats.
+ * adversarial - index << 32: every key has the same low 32 bits.
+ * The keys are uint64_t hashed with HashBytes and a per-map seed; with
+ * "identity" the key itself is the hash (like HashInt), which shows what
+ * the adversarial keys do to a hash that keeps the low bits (quadratic for
+ * big n- keep max_n small).
+ *
+ * The operations (ns_per_op is the mean over all n operations):
+ * resize - inserting into a map allocated with the default capacity, so it
+ * grows on the way (max_ns is the worst resize pause).
+ * insert - inserting into a map reserved for n pairs.
+ * lookup_hit, lookup_miss - looking up the n keys in random order, and n
+ * keys not in the map (a Vector is kept sorted, VectorFind binary searches).
+ * iterate - walking all the pairs, per pair.
+ * erase - erasing the n keys in random order.
+ * clear - clearing a full map, per pair (p99_ns and max_ns are the whole
+ * clear).
+ * Latencies are sampled: one operation in every stride (at least
+ * LATENCY_MIN_STRIDE, at most LATENCY_SAMPLES samples) is timed on its own.
+ *
+ * The output is CSV on stdout, one line per (container, configuration,
+ * distribution, n, operation):
+ * container,config,distribution,n,operation,ns_per_op,p99_ns,max_ns,
+ * bytes_per_entry
+ * bytes_per_entry is the heap the container and its copies of the keys and
+ * values use after the resize run, divided by n (-1 where malloc can not
+ * tell, glibc 2.33 or later can).
+ *
+ * Build with optimizations, against the same sources as Hashmap_test.c:
+ * gcc -std=c99 -O2 -o Hashmap_bench Hashmap_bench.c HashMap.c
+ * ChainedBackend.c ChainedInlineBackend.c RobinHoodBackend.c SwissBackend.c
+ * DenseBackend.c Arena.c Vector.c and the Pair implementation
+ *
+ * @section LICENSE
+ * This program is private and was made for the 2020 67315 course
+ */
+
+// ------------------------------ includes ------------------------------
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "HashMap.h"
+#include "Vector.h"
+#include "Hash.h"
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || \
+    (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define BENCH_HAS_MALLINFO2
+#endif
+
+// -------------------------- const definitions -------------------------
+#define SUCCESS 1
+#define FAIL 0
+
+/**
+ * @def BENCH_MIN_N, BENCH_DEFAULT_MAX_N, BENCH_MAX_N
+ * @brief the smallest n, the default and the allowed largest max_n
+ */
+#define BENCH_MIN_N 1000UL
+#define BENCH_DEFAULT_MAX_N 1000000UL
+#define BENCH_MAX_N 100000000UL
+
+/**
+ * @def LATENCY_SAMPLES
+ * @brief the most operations timed on their own in one run
+ */
+#define LATENCY_SAMPLES 65536UL
+
+/**
+ * @def LATENCY_MIN_STRIDE
+ * @brief at most one operation in this many is timed on its own, so the
+ * clock reads add little to ns_per_op
+ */
+#define LATENCY_MIN_STRIDE 16UL
+
+/**
+ * @def ADVERSARIAL_SHIFT
+ * @brief the adversarial keys are index << ADVERSARIAL_SHIFT
+ */
+#define ADVERSARIAL_SHIFT 32
+
+/**
+ * @def INCREMENTAL_STEP
+ * @brief incremental_resize_step of the "chained_incremental" configuration
+ */
+#define INCREMENTAL_STEP 8
+
+/**
+ * @def BENCH_SHUFFLE_SEED
+ * @brief seed of the random lookup and erase order (the same every run)
+ */
+#define BENCH_SHUFFLE_SEED 0x2545f4914f6cdd1dULL
+
+/**
+ * @def BENCH_LOOP
+ * @brief runs the statement (the variadic part, it may hold commas) for i
+ * in [0, n), timing the whole loop and every stride-th statement on its
+ * own, and summarizes the times into result
+ */
+#define BENCH_LOOP(result, n, i, ...) \
+  do { \
+    size_t stride_ = LatencyStride(n); \
+    size_t countdown_ = 1; \
+    size_t num_samples_ = 0; \
+    uint64_t start_ = NowNs(); \
+    for (size_t i = 0; i < (n); i++) { \
+      if (--countdown_ == 0) { \
+        countdown_ = stride_; \
+        uint64_t op_start_ = NowNs(); \
+        __VA_ARGS__; \
+        latency_samples[num_samples_++] = NowNs() - op_start_; \
+      } else { \
+        __VA_ARGS__; \
+      } \
+    } \
+    Summarize(&(result), NowNs() - start_, (n), num_samples_); \
+  } while (0)
+
+// ------------------------------ types ------------------------------
+/**
+ * @enum KeyDist
+ * The distributions of the keys.
+ */
+typedef enum KeyDist {
+  DIST_SEQUENTIAL,
+  DIST_RANDOM,
+  DIST_ADVERSARIAL,
+  NUM_DISTS,
+} KeyDist;
+
+/**
+ * @struct MapConfig
+ * A HashMap configuration to benchmark.
+ * @param name the config column of the output.
+ * @param backend the storage engine.
+ * @param resize_step incremental_resize_step of the map.
+ */
+typedef struct MapConfig {
+  const char *name;
+  HashMapBackend backend;
+  size_t resize_step;
+} MapConfig;
+
+/**
+ * @struct BenchResult
+ * The times of one run of an operation.
+ * @param ns_per_op the mean time of an operation.
+ * @param p99_ns, max_ns the 99th percentile and the worst of the sampled
+ * operations.
+ */
+typedef struct BenchResult {
+  double ns_per_op;
+  double p99_ns;
+  double max_ns;
+} BenchResult;
+
+/**
+ * @struct BenchKeys
+ * The keys of one (distribution, n).
+ * @param hits the n keys inserted.
+ * @param misses n keys never inserted.
+ * @param order a random permutation of [0, n), the lookup and erase order.
+ */
+typedef struct BenchKeys {
+  uint64_t *hits;
+  uint64_t *misses;
+  size_t *order;
+} BenchKeys;
+
+// ------------------------------ globals ------------------------------
+static const char *const dist_names[NUM_DISTS] = {
+    "sequential", "random", "adversarial"
+};
+
+static const MapConfig map_configs[] = {
+    {"chained", HASH_MAP_CHAINED, 0},
+    {"chained_incremental", HASH_MAP_CHAINED, INCREMENTAL_STEP},
+    {"robin_hood", HASH_MAP_ROBIN_HOOD, 0},
+    {"swiss", HASH_MAP_SWISS, 0},
+    {"dense", HASH_MAP_DENSE, 0},
+    {"chained_inline", HASH_MAP_CHAINED_INLINE, 0},
+};
+
+/**
+ * the times of the operations BENCH_LOOP timed on their own
+ */
+static uint64_t latency_samples[LATENCY_SAMPLES];
+
+/**
+ * the results of the operations end here, so they are not optimized away
+ */
+static volatile uint64_t bench_sink;
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * @return a monotonic time in nanoseconds
+ */
+static uint64_t NowNs(void);
+
+/**
+ * @param n number of operations in a run
+ * @return one in how many operations BENCH_LOOP times on its own
+ */
+static size_t LatencyStride(size_t n);
+
+/**
+ * fills a BenchResult from the time of a run and its samples
+ * @param result output
+ * @param total_ns the time of the whole run
+ * @param n number of operations in the run
+ * @param num_samples number of samples in latency_samples
+ */
+static void Summarize(BenchResult *result, uint64_t total_ns, size_t n,
+                      size_t num_samples);
+
+/**
+ * @return the bytes malloc handed out and not freed yet, -1 if unknown
+ */
+static double HeapInUse(void);
+
+/**
+ * prints a line of output
+ * @param bytes_per_entry the bytes_per_entry column
+ */
+static void Report(const char *container, const char *config, KeyDist dist,
+                   size_t n, const char *operation, const BenchResult *result,
+                   double bytes_per_entry);
+
+/**
+ * allocates the keys of a distribution
+ * @return 1 upon success, 0 otherwise
+ */
+static int KeysAlloc(BenchKeys *keys, KeyDist dist, size_t n);
+
+/**
+ * frees the keys of KeysAlloc
+ */
+static void KeysFree(BenchKeys *keys);
+
+/**
+ * benchmarks every operation of a HashMap configuration
+ * @param seeded_hash the hash of the keys
+ * @return 1 upon success, 0 if the map failed or gave a wrong result
+ */
+static int BenchMap(const MapConfig *config, SeededHashFunc seeded_hash,
+                    const BenchKeys *keys, KeyDist dist, size_t n);
+
+/**
+ * benchmarks every operation of a Vector
+ * @return 1 upon success, 0 if the vector failed or gave a wrong result
+ */
+static int BenchVector(const BenchKeys *keys, KeyDist dist, size_t n);
+
+/**
+ * key and value functions of the maps and the vectors (the keys and the
+ * values are uint64_t)
+ */
+static KeyT U64Cpy(KeyT key);
+static int U64Cmp(KeyT key_1, KeyT key_2);
+static void U64Free(KeyT *key);
+static void *U64ElemCpy(const void *elem);
+static int U64ElemCmp(const void *elem_1, const void *elem_2);
+static void U64ElemFree(void **elem);
+static int U64Order(const void *elem_1, const void *elem_2);
+static size_t HashU64(KeyT key, size_t seed);
+static size_t HashU64Identity(KeyT key, size_t seed);
+static int CompareSamples(const void *sample_1, const void *sample_2);
+
+static const PairTraits u64_traits = {
+    U64Cpy, U64Cpy, U64Cmp, U64Cmp, U64Free, U64Free
+};
+
+static uint64_t NowNs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+static size_t LatencyStride(size_t n) {
+  size_t stride = (n + LATENCY_SAMPLES - 1) / LATENCY_SAMPLES;
+  return stride < LATENCY_MIN_STRIDE ? LATENCY_MIN_STRIDE : stride;
+}
+
+static int CompareSamples(const void *sample_1, const void *sample_2) {
+  uint64_t a = *(const uint64_t *) sample_1, b = *(const uint64_t *) sample_2;
+  return (a > b) - (a < b);
+}
+
+static void Summarize(BenchResult *result, uint64_t total_ns, size_t n,
+                      size_t num_samples) {
+  result->ns_per_op = n ? (double) total_ns / (double) n : 0;
+  result->p99_ns = 0;
+  result->max_ns = 0;
+  if (num_samples == 0) {
+    return;
+  }
+  qsort(latency_samples, num_samples, sizeof(uint64_t), CompareSamples);
+  result->p99_ns = (double) latency_samples[(num_samples - 1) * 99 / 100];
+  result->max_ns = (double) latency_samples[num_samples - 1];
+}
+
+static double HeapInUse(void) {
+#ifdef BENCH_HAS_MALLINFO2
+  return (double) mallinfo2().uordblks;
+#else
+  return -1;
+#endif
+}
+
+static void Report(const char *container, const char *config, KeyDist dist,
+                   size_t n, const char *operation, const BenchResult *result,
+                   double bytes_per_entry) {
+  printf("%s,%s,%s,%zu,%s,%.2f,%.0f,%.0f,%.1f\n", container, config,
+         dist_names[dist], n, operation, result->ns_per_op, result->p99_ns,
+         result->max_ns, bytes_per_entry);
+  fflush(stdout);
+}
+
+static int KeysAlloc(BenchKeys *keys, KeyDist dist, size_t n) {
+  keys->hits = malloc(n * sizeof(uint64_t));
+  keys->misses = malloc(n * sizeof(uint64_t));
+  keys->order = malloc(n * sizeof(size_t));
+  if (!keys->hits || !keys->misses || !keys->order) {
+    KeysFree(keys);
+    return FAIL;
+  }
+  //the misses continue the sequence of the hits, so they never repeat one
+  for (size_t i = 0; i < 2 * n; i++) {
+    uint64_t key = i;
+    if (dist == DIST_RANDOM) {
+      key = HashMix64(i + 1);
+    } else if (dist == DIST_ADVERSARIAL) {
+      key = (uint64_t) i << ADVERSARIAL_SHIFT;
+    }
+    if (i < n) {
+      keys->hits[i] = key;
+    } else {
+      keys->misses[i - n] = key;
+    }
+  }
+  //Fisher-Yates shuffle
+  uint64_t state = BENCH_SHUFFLE_SEED;
+  for (size_t i = 0; i < n; i++) {
+    keys->order[i] = i;
+  }
+  for (size_t i = n - 1; i > 0; i--) {
+    state = HashMix64(state);
+    size_t j = (size_t) (state % (i + 1));
+    size_t tmp = keys->order[i];
+    keys->order[i] = keys->order[j];
+    keys->order[j] = tmp;
+  }
+  return SUCCESS;
+}
+
+static void KeysFree(BenchKeys *keys) {
+  free(keys->hits);
+  free(keys->misses);
+  free(keys->order);
+  keys->hits = NULL;
+  keys->misses = NULL;
+  keys->order = NULL;
+}
+
+static int BenchMap(const MapConfig *config, SeededHashFunc seeded_hash,
+                    const BenchKeys *keys, KeyDist dist, size_t n) {
+  HashMapOptions options = {0};
+  options.backend = config->backend;
+  options.traits = &u64_traits;
+  options.seeded_hash = seeded_hash;
+  options.incremental_resize_step = config->resize_step;
+  BenchResult result;
+  size_t wrong = 0;
+
+  double heap_before = HeapInUse();
+  HashMap *map = HashMapAllocWithOptions(NULL, NULL, NULL, NULL, &options);
+  if (!map) {
+    return FAIL;
+  }
+  BENCH_LOOP(result, n, i, {
+    Pair pair = {&keys->hits[i], &keys->hits[i], NULL, NULL, NULL, NULL,
+                 NULL, NULL};
+    wrong += !HashMapInsert(map, &pair);
+  });
+  double heap_after = HeapInUse();
+  double bytes_per_entry = heap_before < 0 ? -1 :
+      (heap_after - heap_before) / (double) n;
+  Report("hashmap", config->name, dist, n, "resize", &result,
+         bytes_per_entry);
+
+  uint64_t sum = 0;
+  BENCH_LOOP(result, n, i, {
+    uint64_t *value = HashMapAt(map, &keys->hits[keys->order[i]]);
+    if (value) {
+      sum += *value;
+    } else {
+      wrong++;
+    }
+  });
+  Report("hashmap", config->name, dist, n, "lookup_hit", &result,
+         bytes_per_entry);
+
+  BENCH_LOOP(result, n, i, {
+    wrong += HashMapContainsKey(map, &keys->misses[i]);
+  });
+  Report("hashmap", config->name, dist, n, "lookup_miss", &result,
+         bytes_per_entry);
+
+  HashMapIterator iterator = HashMapIteratorBegin(map);
+  BENCH_LOOP(result, n, i, {
+    Pair *pair = HashMapIteratorNext(&iterator);
+    if (pair) {
+      sum += *(uint64_t *) pair->key;
+    } else {
+      wrong++;
+    }
+  });
+  Report("hashmap", config->name, dist, n, "iterate", &result,
+         bytes_per_entry);
+
+  BENCH_LOOP(result, n, i, {
+    wrong += !HashMapErase(map, &keys->hits[keys->order[i]]);
+  });
+  Report("hashmap", config->name, dist, n, "erase", &result,
+         bytes_per_entry);
+  wrong += map->size != 0;
+  HashMapFree(&map);
+
+  options.initial_pairs = n;
+  map = HashMapAllocWithOptions(NULL, NULL, NULL, NULL, &options);
+  if (!map) {
+    return FAIL;
+  }
+  BENCH_LOOP(result, n, i, {
+    Pair pair = {&keys->hits[i], &keys->hits[i], NULL, NULL, NULL, NULL,
+                 NULL, NULL};
+    wrong += !HashMapInsert(map, &pair);
+  });
+  Report("hashmap", config->name, dist, n, "insert", &result,
+         bytes_per_entry);
+
+  uint64_t start = NowNs();
+  HashMapClear(map);
+  uint64_t clear_ns = NowNs() - start;
+  Summarize(&result, clear_ns, n, 0);
+  result.p99_ns = result.max_ns = (double) clear_ns;
+  Report("hashmap", config->name, dist, n, "clear", &result,
+         bytes_per_entry);
+  wrong += map->size != 0;
+  HashMapFree(&map);
+
+  bench_sink += sum;
+  if (wrong) {
+    fprintf(stderr, "%s, %s keys, n = %zu: %zu wrong results\n",
+            config->name, dist_names[dist], n, wrong);
+    return FAIL;
+  }
+  return SUCCESS;
+}
+
+static int BenchVector(const BenchKeys *keys, KeyDist dist, size_t n) {
+  BenchResult result;
+  size_t wrong = 0;
+
+  double heap_before = HeapInUse();
+  Vector *vector = VectorAlloc(U64ElemCpy, U64ElemCmp, U64ElemFree);
+  if (!vector) {
+    return FAIL;
+  }
+  BENCH_LOOP(result, n, i, {
+    wrong += !VectorPushBack(vector, &keys->hits[i]);
+  });
+  double heap_after = HeapInUse();
+  double bytes_per_entry = heap_before < 0 ? -1 :
+      (heap_after - heap_before) / (double) n;
+  Report("vector", "default", dist, n, "resize", &result, bytes_per_entry);
+
+  uint64_t sum = 0;
+  BENCH_LOOP(result, n, i, {
+    uint64_t *elem = VectorAt(vector, i);
+    if (elem) {
+      sum += *elem;
+    } else {
+      wrong++;
+    }
+  });
+  Report("vector", "default", dist, n, "iterate", &result, bytes_per_entry);
+
+  //not a per-element operation- VectorSetSorted sorts the vector once
+  wrong += !VectorSetSorted(vector, U64Order);
+  BENCH_LOOP(result, n, i, {
+    wrong += VectorFind(vector, &keys->hits[keys->order[i]]) < 0;
+  });
+  Report("vector", "sorted", dist, n, "lookup_hit", &result,
+         bytes_per_entry);
+
+  BENCH_LOOP(result, n, i, {
+    wrong += VectorFind(vector, &keys->misses[i]) >= 0;
+  });
+  Report("vector", "sorted", dist, n, "lookup_miss", &result,
+         bytes_per_entry);
+
+  //unsorted again, so erasing does not shift the elements after the hole
+  wrong += !VectorSetSorted(vector, NULL);
+  BENCH_LOOP(result, n, i, {
+    wrong += !VectorEraseUnordered(vector, keys->order[i] % vector->size);
+  });
+  Report("vector", "default", dist, n, "erase", &result, bytes_per_entry);
+  wrong += vector->size != 0;
+  VectorFree(&vector);
+
+  vector = VectorAlloc(U64ElemCpy, U64ElemCmp, U64ElemFree);
+  if (!vector) {
+    return FAIL;
+  }
+  wrong += !VectorReserve(vector, n);
+  BENCH_LOOP(result, n, i, {
+    wrong += !VectorPushBack(vector, &keys->hits[i]);
+  });
+  Report("vector", "default", dist, n, "insert", &result, bytes_per_entry);
+
+  uint64_t start = NowNs();
+  VectorClear(vector);
+  uint64_t clear_ns = NowNs() - start;
+  Summarize(&result, clear_ns, n, 0);
+  result.p99_ns = result.max_ns = (double) clear_ns;
+  Report("vector", "default", dist, n, "clear", &result, bytes_per_entry);
+  wrong += vector->size != 0;
+  VectorFree(&vector);
+
+  bench_sink += sum;
+  if (wrong) {
+    fprintf(stderr, "vector, %s keys, n = %zu: %zu wrong results\n",
+            dist_names[dist], n, wrong);
+    return FAIL;
+  }
+  return SUCCESS;
+}
+
+static KeyT U64Cpy(KeyT key) {
+  return U64ElemCpy(key);
+}
+
+static int U64Cmp(KeyT key_1, KeyT key_2) {
+  return U64ElemCmp(key_1, key_2);
+}
+
+static void U64Free(KeyT *key) {
+  U64ElemFree(key);
+}
+
+static void *U64ElemCpy(const void *elem) {
+  uint64_t *new_elem = malloc(sizeof(uint64_t));
+  if (!new_elem) {
+    return NULL;
+  }
+  *new_elem = *(const uint64_t *) elem;
+  return new_elem;
+}
+
+static int U64ElemCmp(const void *elem_1, const void *elem_2) {
+  return *(const uint64_t *) elem_1 == *(const uint64_t *) elem_2;
+}
+
+static void U64ElemFree(void **elem) {
+  if (elem && *elem) {
+    free(*elem);
+    *elem = NULL;
+  }
+}
+
+static int U64Order(const void *elem_1, const void *elem_2) {
+  uint64_t a = *(const uint64_t *) elem_1, b = *(const uint64_t *) elem_2;
+  return (a > b) - (a < b);
+}
+
+static size_t HashU64(KeyT key, size_t seed) {
+  return HashBytes(key, sizeof(uint64_t), seed);
+}
+
+static size_t HashU64Identity(KeyT key, size_t seed) {
+  (void) seed;
+  return (size_t) *(uint64_t *) key;
+}
+
+int main(int argc, char *argv[]) {
+  size_t max_n = BENCH_DEFAULT_MAX_N;
+  if (argc > 1) {
+    max_n = strtoul(argv[1], NULL, 10);
+  }
+  SeededHashFunc seeded_hash = argc > 2 && strcmp(argv[2], "identity") == 0 ?
+      HashU64Identity : HashU64;
+  if (max_n < BENCH_MIN_N || max_n > BENCH_MAX_N) {
+    fprintf(stderr, "Usage: %s [max_n [identity]], %lu <= max_n <= %lu\n",
+            argv[0], BENCH_MIN_N, BENCH_MAX_N);
+    return 1;
+  }
+
+  printf("container,config,distribution,n,operation,ns_per_op,p99_ns,"
+         "max_ns,bytes_per_entry\n");
+  for (size_t n = BENCH_MIN_N; n <= max_n; n *= 10) {
+    for (int dist = 0; dist < NUM_DISTS; dist++) {
+      BenchKeys keys;
+      if (!KeysAlloc(&keys, (KeyDist) dist, n)) {
+        fprintf(stderr, "no memory for %zu keys\n", n);
+        return 1;
+      }
+      int ok = SUCCESS;
+      for (size_t i = 0; ok && i < sizeof(map_configs) /
+          sizeof(map_configs[0]); i++) {
+        ok = BenchMap(&map_configs[i], seeded_hash, &keys, (KeyDist) dist, n);
+      }
+      ok = ok && BenchVector(&keys, (KeyDist) dist, n);
+      KeysFree(&keys);
+      if (!ok) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
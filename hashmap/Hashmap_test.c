@@ -1,15 +1,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "HashMap.h"
 #include "PairCharInt.h"
 #include "Hash.h"
+#include "TypedHashMap.h"
+#include "ConcurrentHashMap.h"
+#include "SnapshotHashMap.h"
+#include "Arena.h"
+#include <pthread.h>
 
 enum errors{SUCCESS, TEST1FAIL, TEST2FAIL, TEST3FAIL, TEST4FAIL, TEST5FAIL,
-    TEST6FAIL};
+    TEST6FAIL, TEST7FAIL, TEST8FAIL, TEST9FAIL, TEST10FAIL, TEST11FAIL,
+    TEST12FAIL, TEST13FAIL, TEST14FAIL, TEST15FAIL, TEST16FAIL,
+    TEST17FAIL, TEST18FAIL, TEST19FAIL, TEST20FAIL,
+    TEST21FAIL, TEST22FAIL, TEST23FAIL, TEST24FAIL};
 #define PAIR_FUNCS CharKeyCpy, IntValueCpy, CharKeyCmp, IntValueCmp, \
 CharKeyFree, IntValueFree
 #define FAIL 0
+#define BACKEND_TEST_PAIRS 100
+#define TEST_THREADS 4
+
+DEFINE_HASHMAP(IntIntMap, int, int, TypedHashInt, TypedEqualsInt)
 
 
 int Test1();
@@ -18,6 +31,32 @@ int Test3();
 int Test4();
 int Test5();
 int Test6();
+int Test7();
+int Test8();
+int Test9();
+int Test10();
+int Test11();
+int Test12();
+int Test13();
+int Test14();
+int Test15();
+int Test16();
+int Test17();
+int Test18();
+int TestValueIndex(const HashMapOptions *options);
+int Test19();
+int Test20();
+int TestClearKeepCapacity(const HashMapOptions *options);
+int Test21();
+int Test22();
+int Test23();
+int Test24();
+int TestStats(const HashMapOptions *options);
+int TestResizeMoves(const HashMapOptions *options);
+int TestKeptHashes(const HashMapOptions *options);
+int TestIterator(const HashMapOptions *options);
+int TestBatch(const HashMapOptions *options);
+int TestOptions(const HashMapOptions *options);
 int main()
 {
   printf("TEST1: HashMapAlloc + HashMapFree\n");
@@ -68,10 +107,1407 @@ int main()
   }
   printf("TEST 6 PASSED!\n\n");
 
+  printf("TEST 7: HASH_MAP_ROBIN_HOOD backend\n");
+  int result_test7 = Test7();
+  if(result_test7 != 0){
+    fprintf(stderr, "TEST 7 FAILED\n");
+    return 7;
+  }
+  printf("TEST 7 PASSED!\n\n");
+
+  printf("TEST 8: HASH_MAP_SWISS backend\n");
+  int result_test8 = Test8();
+  if(result_test8 != 0){
+    fprintf(stderr, "TEST 8 FAILED\n");
+    return 8;
+  }
+  printf("TEST 8 PASSED!\n\n");
+
+  printf("TEST 9: DEFINE_HASHMAP (int -> int)\n");
+  int result_test9 = Test9();
+  if(result_test9 != 0){
+    fprintf(stderr, "TEST 9 FAILED\n");
+    return 9;
+  }
+  printf("TEST 9 PASSED!\n\n");
+
+  printf("TEST 10: incremental resize\n");
+  int result_test10 = Test10();
+  if(result_test10 != 0){
+    fprintf(stderr, "TEST 10 FAILED\n");
+    return 10;
+  }
+  printf("TEST 10 PASSED!\n\n");
+
+  printf("TEST 11: map with PairTraits\n");
+  int result_test11 = Test11();
+  if(result_test11 != 0){
+    fprintf(stderr, "TEST 11 FAILED\n");
+    return 11;
+  }
+  printf("TEST 11 PASSED!\n\n");
+
+  printf("TEST 12: seeded strong hashes\n");
+  int result_test12 = Test12();
+  if(result_test12 != 0){
+    fprintf(stderr, "TEST 12 FAILED\n");
+    return 12;
+  }
+  printf("TEST 12 PASSED!\n\n");
+
+  printf("TEST 13: HashMapInsertBatch + HashMapAtBatch\n");
+  int result_test13 = Test13();
+  if(result_test13 != 0){
+    fprintf(stderr, "TEST 13 FAILED\n");
+    return 13;
+  }
+  printf("TEST 13 PASSED!\n\n");
+
+  printf("TEST 14: capacity reservation and shrink policies\n");
+  int result_test14 = Test14();
+  if(result_test14 != 0){
+    fprintf(stderr, "TEST 14 FAILED\n");
+    return 14;
+  }
+  printf("TEST 14 PASSED!\n\n");
+
+  printf("TEST 15: ConcurrentHashMap\n");
+  int result_test15 = Test15();
+  if(result_test15 != 0){
+    fprintf(stderr, "TEST 15 FAILED\n");
+    return 15;
+  }
+  printf("TEST 15 PASSED!\n\n");
+
+  printf("TEST 16: SnapshotHashMap\n");
+  int result_test16 = Test16();
+  if(result_test16 != 0){
+    fprintf(stderr, "TEST 16 FAILED\n");
+    return 16;
+  }
+  printf("TEST 16 PASSED!\n\n");
+
+  printf("TEST 17: HASH_MAP_DENSE backend + HashMapIterator\n");
+  int result_test17 = Test17();
+  if(result_test17 != 0){
+    fprintf(stderr, "TEST 17 FAILED\n");
+    return 17;
+  }
+  printf("TEST 17 PASSED!\n\n");
+
+  printf("TEST 18: value index\n");
+  int result_test18 = Test18();
+  if(result_test18 != 0){
+    fprintf(stderr, "TEST 18 FAILED\n");
+    return 18;
+  }
+  printf("TEST 18 PASSED!\n\n");
+
+  printf("TEST 19: Arena + map entries in an arena\n");
+  int result_test19 = Test19();
+  if(result_test19 != 0){
+    fprintf(stderr, "TEST 19 FAILED\n");
+    return 19;
+  }
+  printf("TEST 19 PASSED!\n\n");
+
+  printf("TEST 20: HashMapClearKeepCapacity\n");
+  int result_test20 = Test20();
+  if(result_test20 != 0){
+    fprintf(stderr, "TEST 20 FAILED\n");
+    return 20;
+  }
+  printf("TEST 20 PASSED!\n\n");
+
+  printf("TEST 21: HASH_MAP_CHAINED_INLINE backend\n");
+  int result_test21 = Test21();
+  if(result_test21 != 0){
+    fprintf(stderr, "TEST 21 FAILED\n");
+    return 21;
+  }
+  printf("TEST 21 PASSED!\n\n");
+
+  printf("TEST 22: HashMapGetStats\n");
+  int result_test22 = Test22();
+  if(result_test22 != 0){
+    fprintf(stderr, "TEST 22 FAILED\n");
+    return 22;
+  }
+  printf("TEST 22 PASSED!\n\n");
+
+  printf("TEST 23: resizing moves the pairs\n");
+  int result_test23 = Test23();
+  if(result_test23 != 0){
+    fprintf(stderr, "TEST 23 FAILED\n");
+    return 23;
+  }
+  printf("TEST 23 PASSED!\n\n");
+
+  printf("TEST 24: chained buckets keep the hashes\n");
+  int result_test24 = Test24();
+  if(result_test24 != 0){
+    fprintf(stderr, "TEST 24 FAILED\n");
+    return 24;
+  }
+  printf("TEST 24 PASSED!\n\n");
+
   printf("ALL TESTS PASSED :)\n");
   return 0;
 }
 
+int Test7() {
+  HashMapOptions options = {0};
+  options.backend = HASH_MAP_ROBIN_HOOD;
+  return TestOptions(&options) ? TEST7FAIL : SUCCESS;
+}
+
+int Test10() {
+  HashMapOptions options = {0};
+  options.incremental_resize_step = 1;
+  if(TestOptions(&options)){
+    return TEST10FAIL;
+  }
+  //a shrink right after a grow waits for the grow's migration instead of
+  //migrating the rest of the old buckets in one operation
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, &options);
+  int fail_flag = !h_map;
+  char char_arr[BACKEND_TEST_PAIRS];
+  for(int i = 0; i < 97 && !fail_flag; i++){
+    char_arr[i] = (char)(i + 1);
+    Pair *pair = PairAlloc(&char_arr[i], &i, PAIR_FUNCS);
+    fail_flag = HashMapInsert(h_map, pair) != 1;
+    PairFree(&pair);
+  }
+  //the 97th pair started a grow to 256 buckets, 95 pairs fit in 128
+  fail_flag = fail_flag || h_map->capacity != 256 ||
+      HashMapErase(h_map, &char_arr[0]) != 1 ||
+      HashMapErase(h_map, &char_arr[1]) != 1 ||
+      HashMapShrinkToFit(h_map) != 1 || h_map->capacity != 256;
+  //each lookup moves one of the 128 old buckets
+  for(int i = 2; i < 2 * 97 && !fail_flag; i++){
+    fail_flag = !HashMapContainsKey(h_map, &char_arr[2 + i % 95]);
+  }
+  fail_flag = fail_flag || HashMapShrinkToFit(h_map) != 1 ||
+      h_map->capacity != 128 || h_map->size != 95;
+  //the shrink is migrating now- a reserve finishes it and grows anyway
+  fail_flag = fail_flag || HashMapReserve(h_map, 1000) != 1 ||
+      h_map->capacity != 2048;
+  for(int i = 2; i < 97 && !fail_flag; i++){
+    fail_flag = !HashMapContainsKey(h_map, &char_arr[i]);
+  }
+  HashMapFree(&h_map);
+  return fail_flag ? TEST10FAIL : SUCCESS;
+}
+
+int Test11() {
+  static const PairTraits traits = {PAIR_FUNCS};
+  HashMapOptions options = {0};
+  options.traits = &traits;
+  if(TestOptions(&options)){
+    return TEST11FAIL;
+  }
+  options.backend = HASH_MAP_SWISS;
+  return TestOptions(&options) ? TEST11FAIL : SUCCESS;
+}
+
+int Test12() {
+  //doubles in [0,1) all hash to 0 with HashDouble- count the low bit
+  //patterns (buckets of a 64 buckets map) HashDoubleSeeded spreads them to
+  char used[64] = {0};
+  int used_buckets = 0;
+  for(int i = 0; i < 64; i++){
+    double key = i / 64.0;
+    size_t index = HashDoubleSeeded(&key, 7) & 63;
+    used_buckets += !used[index];
+    used[index] = 1;
+  }
+  double zero = 0.0, minus_zero = -0.0;
+  char str_1[] = "timestamp-1", str_2[] = "timestamp-1";
+  if(used_buckets < 32 ||
+  HashDoubleSeeded(&zero, 7) != HashDoubleSeeded(&minus_zero, 7) ||
+  HashStringSeeded(str_1, 7) != HashStringSeeded(str_2, 7) ||
+  HashStringSeeded(str_1, 7) == HashStringSeeded(str_1, 8)){
+    fprintf(stderr, "TEST 12: strong hashes returned wrong results\n");
+    return TEST12FAIL;
+  }
+
+  HashMapOptions options = {0};
+  options.seeded_hash = HashCharSeeded;
+  if(TestOptions(&options)){
+    return TEST12FAIL;
+  }
+  options.backend = HASH_MAP_ROBIN_HOOD;
+  options.seed = 42;
+  return TestOptions(&options) ? TEST12FAIL : SUCCESS;
+}
+
+/**
+ * the work of one thread of Test15
+ */
+typedef struct ConcurrentTestArgs {
+  ConcurrentHashMap *map;
+  int first_key;
+  int fail_flag;
+} ConcurrentTestArgs;
+
+/**
+ * copies the int value found by ConcurrentHashMapAt
+ */
+void CopyIntValue(ValueT value, void *out) {
+  *(int *)out = *(int *)value;
+}
+
+/**
+ * inserts BACKEND_TEST_PAIRS / TEST_THREADS keys (from first_key on), looks
+ * all of them up and erases the even ones
+ */
+void *ConcurrentTestThread(void *arg) {
+  ConcurrentTestArgs *args = arg;
+  int num_keys = BACKEND_TEST_PAIRS / TEST_THREADS;
+  for(int i = 0; i < num_keys && !args->fail_flag; i++){
+    char key = (char)(args->first_key + i);
+    int value = i;
+    Pair *pair = PairAlloc(&key, &value, PAIR_FUNCS);
+    args->fail_flag = ConcurrentHashMapInsert(args->map, pair) != 1;
+    PairCharIntFree((void*)&pair);
+  }
+  for(int i = 0; i < num_keys && !args->fail_flag; i++){
+    char key = (char)(args->first_key + i);
+    int value = -1;
+    args->fail_flag = ConcurrentHashMapAt(args->map, &key, CopyIntValue,
+        &value) != 1 || value != i;
+  }
+  for(int i = 0; i < num_keys && !args->fail_flag; i += 2){
+    char key = (char)(args->first_key + i);
+    args->fail_flag = ConcurrentHashMapErase(args->map, &key) != 1;
+  }
+  return NULL;
+}
+
+int Test15() {
+  ConcurrentHashMap *map = ConcurrentHashMapAlloc(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, 8, NULL);
+  if(!map){
+    fprintf(stderr, "TEST 15: Failed to allocate map\n");
+    return TEST15FAIL;
+  }
+  pthread_t threads[TEST_THREADS];
+  int created[TEST_THREADS];
+  ConcurrentTestArgs args[TEST_THREADS];
+  int fail_flag = 0;
+  for(int i = 0; i < TEST_THREADS; i++){
+    args[i].map = map;
+    args[i].first_key = 1 + i * (BACKEND_TEST_PAIRS / TEST_THREADS);
+    args[i].fail_flag = 0;
+    created[i] = !pthread_create(&threads[i], NULL, ConcurrentTestThread,
+        &args[i]);
+  }
+  for(int i = 0; i < TEST_THREADS; i++){
+    if(created[i]){
+      pthread_join(threads[i], NULL);
+    }
+    fail_flag = fail_flag || !created[i] || args[i].fail_flag;
+  }
+  //every thread erased the keys at its even offsets
+  char odd_key = 2, even_key = 1;
+  size_t expected_size = TEST_THREADS * (BACKEND_TEST_PAIRS / TEST_THREADS /
+      2);
+  if(!fail_flag && (ConcurrentHashMapGetSize(map) != expected_size || !ConcurrentHashMapContainsKey(map, &odd_key) ||
+  ConcurrentHashMapContainsKey(map, &even_key))){
+    fail_flag = 1;
+  }
+  ConcurrentHashMapClear(map);
+  if(!fail_flag && ConcurrentHashMapGetSize(map) != 0){
+    fail_flag = 1;
+  }
+  ConcurrentHashMapFree(&map);
+  if(fail_flag){
+    fprintf(stderr, "TEST 15: concurrent map returned wrong results\n");
+    return TEST15FAIL;
+  }
+  return SUCCESS;
+}
+
+/**
+ * the work of one reader thread of Test16
+ */
+typedef struct SnapshotTestArgs {
+  SnapshotHashMap *map;
+  int done;
+  int fail_flag;
+} SnapshotTestArgs;
+
+/**
+ * looks the keys up until the writer is done: a key the writer inserted
+ * must stay in the map (with its value) in every later snapshot
+ */
+void *SnapshotTestReader(void *arg) {
+  SnapshotTestArgs *args = arg;
+  SnapshotReader *reader = SnapshotHashMapRegisterReader(args->map);
+  args->fail_flag = !reader;
+  int seen = 0;
+  while(!args->fail_flag && !__atomic_load_n(&args->done, __ATOMIC_SEQ_CST)){
+    for(int i = 0; i < seen && !args->fail_flag; i++){
+      char key = (char)(i + 1);
+      int value = -1;
+      args->fail_flag = SnapshotHashMapAt(args->map, reader, &key,
+          CopyIntValue, &value) != 1 || value != i;
+    }
+    char next_key = (char)(seen + 1);
+    seen += seen < BACKEND_TEST_PAIRS &&
+        SnapshotHashMapContainsKey(args->map, reader, &next_key);
+  }
+  SnapshotHashMapUnregisterReader(args->map, &reader);
+  return NULL;
+}
+
+/**
+ * erases the even keys of the version, as one update
+ */
+int SnapshotTestEraseEven(HashMap *version, void *arg) {
+  (void)arg;
+  for(int i = 0; i < BACKEND_TEST_PAIRS; i += 2){
+    char key = (char)(i + 1);
+    if(!HashMapErase(version, &key)){
+      return FAIL;
+    }
+  }
+  return 1;
+}
+
+int Test16() {
+  //the versions are copies, and a map in an arena can not be copied
+  Arena *arena = ArenaAlloc();
+  HashMapOptions in_arena = {0};
+  in_arena.arena = arena;
+  SnapshotHashMap *map = SnapshotHashMapAlloc(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, &in_arena);
+  ArenaFree(&arena);
+  if(map){
+    fprintf(stderr, "TEST 16: a snapshot map accepted an arena\n");
+    SnapshotHashMapFree(&map);
+    return TEST16FAIL;
+  }
+  map = SnapshotHashMapAlloc(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, NULL);
+  if(!map){
+    fprintf(stderr, "TEST 16: Failed to allocate map\n");
+    return TEST16FAIL;
+  }
+  pthread_t threads[TEST_THREADS];
+  int created[TEST_THREADS];
+  SnapshotTestArgs args = {map, 0, 0};
+  SnapshotTestArgs reader_args[TEST_THREADS];
+  for(int i = 0; i < TEST_THREADS; i++){
+    reader_args[i] = args;
+    created[i] = !pthread_create(&threads[i], NULL, SnapshotTestReader,
+        &reader_args[i]);
+  }
+  int fail_flag = 0;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    char key = (char)(i + 1);
+    Pair *pair = PairAlloc(&key, &i, PAIR_FUNCS);
+    fail_flag = SnapshotHashMapInsert(map, pair) != 1;
+    PairCharIntFree((void*)&pair);
+  }
+  for(int i = 0; i < TEST_THREADS; i++){
+    __atomic_store_n(&reader_args[i].done, 1, __ATOMIC_SEQ_CST);
+  }
+  for(int i = 0; i < TEST_THREADS; i++){
+    if(created[i]){
+      pthread_join(threads[i], NULL);
+    }
+    fail_flag = fail_flag || !created[i] || reader_args[i].fail_flag;
+  }
+
+  //a snapshot stays the same while the map is changed
+  SnapshotReader *reader = SnapshotHashMapRegisterReader(map);
+  HashMap *snapshot = SnapshotHashMapReadBegin(map, reader);
+  char odd_key = 2, even_key = 1;
+  if(!fail_flag && (!snapshot ||
+  !SnapshotHashMapUpdate(map, SnapshotTestEraseEven, NULL) ||
+  snapshot->size != BACKEND_TEST_PAIRS ||
+  !HashMapContainsKey(snapshot, &even_key))){
+    fail_flag = 1;
+  }
+  SnapshotHashMapReadEnd(reader);
+  if(!fail_flag && (SnapshotHashMapGetSize(map, reader) !=
+  BACKEND_TEST_PAIRS / 2 ||
+  !SnapshotHashMapContainsKey(map, reader, &odd_key) ||
+  SnapshotHashMapContainsKey(map, reader, &even_key) ||
+  SnapshotHashMapErase(map, &even_key) ||
+  !SnapshotHashMapErase(map, &odd_key))){
+    fail_flag = 1;
+  }
+  SnapshotHashMapUnregisterReader(map, &reader);
+  SnapshotHashMapFree(&map);
+  if(fail_flag){
+    fprintf(stderr, "TEST 16: snapshot map returned wrong results\n");
+    return TEST16FAIL;
+  }
+  return SUCCESS;
+}
+
+int Test17() {
+  static const PairTraits traits = {PAIR_FUNCS};
+  HashMapOptions options = {0};
+  options.backend = HASH_MAP_DENSE;
+  if(TestOptions(&options)){
+    return TEST17FAIL;
+  }
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE; backend++){
+    options.backend = (HashMapBackend) backend;
+    if(TestIterator(&options)){
+      return TEST17FAIL;
+    }
+  }
+  options.traits = &traits;
+  if(TestIterator(&options)){
+    return TEST17FAIL;
+  }
+  options.traits = NULL;
+  options.backend = HASH_MAP_CHAINED;
+  options.incremental_resize_step = 1;
+  return TestIterator(&options) ? TEST17FAIL : SUCCESS;
+}
+
+/**
+ * walks a map of BACKEND_TEST_PAIRS pairs, erasing the pairs with even
+ * values on the way, and checks every pair was visited exactly once
+ */
+int TestIterator(const HashMapOptions *options) {
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, options);
+  if(!h_map){
+    fprintf(stderr, "Failed to allocate hash map\n");
+    return 1;
+  }
+  int fail_flag = 0;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    char key = (char)(i + 1);
+    Pair *pair = PairAlloc(&key, &i, PAIR_FUNCS);
+    fail_flag = HashMapInsert(h_map, pair) != 1;
+    PairCharIntFree((void*)&pair);
+  }
+
+  int visits[BACKEND_TEST_PAIRS] = {0};
+  HashMapIterator iterator = HashMapIteratorBegin(h_map);
+  Pair *pair = NULL;
+  while(!fail_flag && (pair = HashMapIteratorNext(&iterator)) != NULL){
+    int value = *(int *)pair->value;
+    visits[value]++;
+    if(*(char *)pair->key != value + 1 ||
+    (value % 2 == 0 && !HashMapIteratorErase(&iterator))){
+      fail_flag = 1;
+    }
+  }
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    char key = (char)(i + 1);
+    if(visits[i] != 1 || HashMapContainsKey(h_map, &key) != i % 2){
+      fprintf(stderr, "pair #%d visited %d times\n", i, visits[i]);
+      fail_flag = 1;
+    }
+  }
+  if(!fail_flag && (h_map->size != BACKEND_TEST_PAIRS / 2 ||
+  HashMapIteratorErase(&iterator))){
+    fail_flag = 1;
+  }
+
+  //a second walk only meets the pairs that were kept
+  int num_visited = 0;
+  iterator = HashMapIteratorBegin(h_map);
+  while(!fail_flag && (pair = HashMapIteratorNext(&iterator)) != NULL){
+    num_visited++;
+    fail_flag = *(int *)pair->value % 2 == 0;
+  }
+  if(!fail_flag && num_visited != BACKEND_TEST_PAIRS / 2){
+    fail_flag = 1;
+  }
+  HashMapFree(&h_map);
+  return fail_flag;
+}
+
+int Test18() {
+  static const PairTraits traits = {PAIR_FUNCS};
+  HashMapOptions options = {0};
+  options.value_hash = HashInt;
+  if(TestOptions(&options) || TestValueIndex(&options)){
+    return TEST18FAIL;
+  }
+  options.traits = &traits;
+  options.backend = HASH_MAP_DENSE;
+  return TestOptions(&options) || TestValueIndex(&options) ? TEST18FAIL :
+      SUCCESS;
+}
+
+/**
+ * fills a map with 10 keys for every value, and checks the value index
+ * follows replacing, erasing, copying and clearing
+ */
+int TestValueIndex(const HashMapOptions *options) {
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, options);
+  if(!h_map){
+    fprintf(stderr, "Failed to allocate hash map\n");
+    return 1;
+  }
+  int fail_flag = 0;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    char key = (char)(i + 1);
+    int value = i % 10;
+    Pair *pair = PairAlloc(&key, &value, PAIR_FUNCS);
+    fail_flag = HashMapInsert(h_map, pair) != 1;
+    PairCharIntFree((void*)&pair);
+  }
+  int three = 3, four = 4, ten = 10;
+  if(!fail_flag && (!HashMapContainsValue(h_map, &three) ||
+  HashMapContainsValue(h_map, &ten))){
+    fail_flag = 1;
+  }
+  //the keys of value 3 (and key 4, the first with 3) move to other values
+  for(int i = 3; i < BACKEND_TEST_PAIRS && !fail_flag; i += 10){
+    char key = (char)(i + 1);
+    if(i == 3){
+      Pair *pair = PairAlloc(&key, &ten, PAIR_FUNCS);
+      fail_flag = HashMapInsert(h_map, pair) != 1;
+      PairCharIntFree((void*)&pair);
+    } else {
+      fail_flag = HashMapErase(h_map, &key) != 1;
+    }
+  }
+  if(!fail_flag && (HashMapContainsValue(h_map, &three) ||
+  !HashMapContainsValue(h_map, &ten))){
+    fail_flag = 1;
+  }
+  //the iterator erases all the keys of value 4
+  HashMapIterator iterator = HashMapIteratorBegin(h_map);
+  Pair *pair = NULL;
+  while(!fail_flag && (pair = HashMapIteratorNext(&iterator)) != NULL){
+    if(*(int *)pair->value == four){
+      fail_flag = !HashMapIteratorErase(&iterator);
+    }
+  }
+  HashMap *copy = HashMapCopy(h_map);
+  if(!fail_flag && (!copy || HashMapContainsValue(copy, &four) ||
+  !HashMapContainsValue(copy, &ten))){
+    fail_flag = 1;
+  }
+  HashMapClear(h_map);
+  if(!fail_flag && HashMapContainsValue(h_map, &ten)){
+    fail_flag = 1;
+  }
+  HashMapFree(&copy);
+  HashMapFree(&h_map);
+  return fail_flag;
+}
+
+/**
+ * the arena the keys and values of Test19 are copied to
+ */
+Arena *test_arena = NULL;
+
+/**
+ * copies a char key to test_arena
+ */
+void *ArenaCharCpy(void *key) {
+  char *copy = ArenaMalloc(test_arena, sizeof(char));
+  if(copy){
+    *copy = *(char *)key;
+  }
+  return copy;
+}
+
+/**
+ * copies an int value to test_arena
+ */
+void *ArenaIntCpy(void *value) {
+  int *copy = ArenaMalloc(test_arena, sizeof(int));
+  if(copy){
+    *copy = *(int *)value;
+  }
+  return copy;
+}
+
+int Test19() {
+  test_arena = ArenaAlloc();
+  if(!test_arena){
+    fprintf(stderr, "TEST 19: Failed to allocate arena\n");
+    return TEST19FAIL;
+  }
+  //a released block is reused by the next block of its size class
+  char *block = ArenaMalloc(test_arena, 24);
+  ArenaRelease(test_arena, block, 24);
+  char *large = ArenaMalloc(test_arena, 2 * ARENA_MAX_SMALL);
+  int fail_flag = !block || (size_t)block % ARENA_ALIGN != 0 || !large ||
+      ArenaMalloc(test_arena, 20) != block;
+  //sizes that would wrap when rounded up are refused
+  fail_flag = fail_flag || ArenaMalloc(test_arena, SIZE_MAX) ||
+      ArenaMalloc(test_arena, SIZE_MAX - ARENA_ALIGN);
+  ArenaRelease(test_arena, block, SIZE_MAX);
+  fail_flag = fail_flag || ArenaMalloc(test_arena, 24) == block;
+  ArenaReset(test_arena);
+
+  //entries from the arena, keys and values freed one by one
+  static const PairTraits traits = {PAIR_FUNCS};
+  HashMapOptions options = {0};
+  options.traits = &traits;
+  options.arena = test_arena;
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE &&
+  !fail_flag; backend++){
+    options.backend = (HashMapBackend) backend;
+    fail_flag = TestOptions(&options);
+  }
+
+  //keys and values owned by the arena- the map frees only the entries
+  static const PairTraits arena_traits = {ArenaCharCpy, ArenaIntCpy,
+      CharKeyCmp, IntValueCmp, NULL, NULL};
+  options.traits = &arena_traits;
+  options.arena_owns_keys = 1;
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE &&
+  !fail_flag; backend++){
+    options.backend = (HashMapBackend) backend;
+    fail_flag = TestOptions(&options);
+  }
+  //the map never resets the arena: a block its owner allocated after the
+  //last reset stays allocated, and a copy shares the arena
+  ArenaReset(test_arena);
+  block = ArenaMalloc(test_arena, 24);
+  char key = 'a';
+  int value = 1;
+  Pair *pair = PairAlloc(&key, &value, PAIR_FUNCS);
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, NULL, NULL, NULL,
+      &options);
+  HashMap *copy = NULL;
+  fail_flag = fail_flag || !h_map || HashMapInsert(h_map, pair) != 1 ||
+      !(copy = HashMapCopy(h_map)) || !HashMapContainsKey(copy, &key);
+  HashMapClear(h_map);
+  HashMapFree(&copy);
+  HashMapFree(&h_map);
+  fail_flag = fail_flag || ArenaMalloc(test_arena, 24) == block;
+  PairFree(&pair);
+  ArenaFree(&test_arena);
+
+  //an arena handed over to the map- freed with it (a leak fails the test
+  //under a leak checker), and never shared with a copy
+  options.map_owns_arena = 1;
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE &&
+  !fail_flag; backend++){
+    options.backend = (HashMapBackend) backend;
+    options.arena = test_arena = ArenaAlloc();
+    fail_flag = !test_arena || TestOptions(&options);
+    options.arena = test_arena = ArenaAlloc();
+    h_map = HashMapAllocWithOptions(HashChar, NULL, NULL, NULL, &options);
+    fail_flag = fail_flag || !h_map || HashMapCopy(h_map);
+    HashMapFree(&h_map);
+  }
+  test_arena = ArenaAlloc();
+  options.arena = test_arena;
+  options.arena_owns_keys = 0;
+  options.traits = &traits;
+  if(!fail_flag && HashMapAllocWithOptions(HashChar, NULL, NULL, NULL,
+      &options)){
+    fail_flag = 1;
+  }
+  //traits without free functions need an arena that owns the keys
+  HashMapOptions no_arena = {0};
+  no_arena.traits = &arena_traits;
+  no_arena.arena_owns_keys = 1;
+  HashMapOptions not_owned = {0};
+  not_owned.traits = &arena_traits;
+  not_owned.arena = test_arena;
+  if(!fail_flag && (
+  HashMapAllocWithOptions(HashChar, NULL, NULL, NULL, &no_arena) ||
+  HashMapAllocWithOptions(HashChar, NULL, NULL, NULL, &not_owned))){
+    fail_flag = 1;
+  }
+  ArenaFree(&test_arena);
+  if(fail_flag){
+    fprintf(stderr, "TEST 19: arena returned wrong results\n");
+    return TEST19FAIL;
+  }
+  return SUCCESS;
+}
+
+int Test20() {
+  static const PairTraits arena_traits = {ArenaCharCpy, ArenaIntCpy,
+      CharKeyCmp, IntValueCmp, NULL, NULL};
+  HashMapOptions options = {0};
+  options.value_hash = HashInt;
+  int fail_flag = 0;
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE &&
+  !fail_flag; backend++){
+    options.backend = (HashMapBackend) backend;
+    fail_flag = TestClearKeepCapacity(&options);
+  }
+  //cleared in the middle of an incremental resize
+  HashMapOptions incremental = {0};
+  incremental.incremental_resize_step = 1;
+  fail_flag = fail_flag || TestClearKeepCapacity(&incremental);
+
+  //keys and values owned by the arena- clearing frees only the entries
+  test_arena = ArenaAlloc();
+  HashMapOptions in_arena = {0};
+  in_arena.traits = &arena_traits;
+  in_arena.arena = test_arena;
+  in_arena.arena_owns_keys = 1;
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE &&
+  !fail_flag; backend++){
+    in_arena.backend = (HashMapBackend) backend;
+    fail_flag = !test_arena || TestClearKeepCapacity(&in_arena);
+  }
+  ArenaFree(&test_arena);
+
+  //an arena the map owns is reset instead of freeing pair by pair
+  in_arena.map_owns_arena = 1;
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE &&
+  !fail_flag; backend++){
+    in_arena.backend = (HashMapBackend) backend;
+    in_arena.arena = test_arena = ArenaAlloc();
+    HashMap *h_map = HashMapAllocWithOptions(HashChar, NULL, NULL, NULL,
+        &in_arena);
+    fail_flag = !h_map;
+    for(int round = 0; round < 2 && !fail_flag; round++){
+      for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+        char key = (char)(i + 1);
+        Pair *pair = PairAlloc(&key, &i, PAIR_FUNCS);
+        fail_flag = HashMapInsert(h_map, pair) != 1;
+        PairCharIntFree((void*)&pair);
+      }
+      HashMapClearKeepCapacity(h_map);
+      fail_flag = fail_flag || h_map->size != 0 || test_arena->used != 0 ||
+          test_arena->large != NULL;
+    }
+    HashMapFree(&h_map);
+  }
+  test_arena = NULL;
+  if(fail_flag){
+    fprintf(stderr, "TEST 20: clearing changed the capacity or kept pairs\n");
+    return TEST20FAIL;
+  }
+  return SUCCESS;
+}
+
+/**
+ * fills a map and clears it (keeping its capacity) a few times, and checks
+ * no pair survives a clear and the capacity never changes
+ */
+int TestClearKeepCapacity(const HashMapOptions *options) {
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, options);
+  if(!h_map){
+    fprintf(stderr, "Failed to allocate hash map\n");
+    return 1;
+  }
+  int fail_flag = 0;
+  size_t capacity = 0;
+  for(int round = 0; round < 3 && !fail_flag; round++){
+    for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+      char key = (char)(i + 1);
+      int value = i + round;
+      Pair *pair = PairAlloc(&key, &value, PAIR_FUNCS);
+      fail_flag = HashMapInsert(h_map, pair) != 1;
+      PairCharIntFree((void*)&pair);
+    }
+    if(round == 0){
+      capacity = h_map->capacity;
+    }
+    char first_key = 1;
+    int last_value = BACKEND_TEST_PAIRS - 1 + round;
+    if(!fail_flag && (h_map->capacity != capacity ||
+    *(int *)HashMapAt(h_map, &first_key) != round)){
+      fail_flag = 1;
+    }
+    HashMapClearKeepCapacity(h_map);
+    if(!fail_flag && (h_map->size != 0 || h_map->capacity != capacity ||
+    HashMapContainsKey(h_map, &first_key) ||
+    HashMapContainsValue(h_map, &last_value))){
+      fail_flag = 1;
+    }
+    HashMapIterator iterator = HashMapIteratorBegin(h_map);
+    fail_flag = fail_flag || HashMapIteratorNext(&iterator) != NULL;
+  }
+  HashMapFree(&h_map);
+  return fail_flag;
+}
+
+/**
+ * sends every char key to one of three buckets, whatever the capacity
+ */
+size_t ThreeBucketsHash(KeyT key, size_t seed) {
+  (void) seed;
+  return (size_t)(*(char *)key % 3);
+}
+
+int Test21() {
+  HashMapOptions options = {0};
+  options.backend = HASH_MAP_CHAINED_INLINE;
+  options.value_hash = HashInt;
+  if(TestOptions(&options) || TestIterator(&options) ||
+  TestValueIndex(&options)){
+    return TEST21FAIL;
+  }
+  //three crowded buckets- most pairs live in the overflows
+  options.seeded_hash = ThreeBucketsHash;
+  return TestOptions(&options) || TestIterator(&options) ||
+      TestValueIndex(&options) ? TEST21FAIL : SUCCESS;
+}
+
+int Test22() {
+  HashMapOptions options = {0};
+  int fail_flag = 0;
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE &&
+  !fail_flag; backend++){
+    options.backend = (HashMapBackend) backend;
+    options.seeded_hash = NULL;
+    fail_flag = TestStats(&options);
+    //degenerate hashing- every pair in one of three buckets
+    options.seeded_hash = ThreeBucketsHash;
+    fail_flag = fail_flag || TestStats(&options);
+  }
+  if(fail_flag){
+    fprintf(stderr, "TEST 22: HashMapGetStats reported wrong stats\n");
+    return TEST22FAIL;
+  }
+  return SUCCESS;
+}
+
+/**
+ * fills a map, checks what HashMapGetStats reports on it, and empties it
+ * @param options the options of the map (a seeded_hash puts all the keys
+ * in three buckets)
+ * @return 0 upon success, 1 otherwise
+ */
+int TestStats(const HashMapOptions *options) {
+  char char_arr[BACKEND_TEST_PAIRS];
+  int int_arr[BACKEND_TEST_PAIRS];
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, options);
+  int fail_flag = !h_map;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    char_arr[i] = (char)(i + 1);
+    int_arr[i] = i;
+    Pair *pair = PairAlloc(&char_arr[i], &int_arr[i], PAIR_FUNCS);
+    fail_flag = HashMapInsert(h_map, pair) != 1;
+    PairFree(&pair);
+  }
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    fail_flag = !HashMapContainsKey(h_map, &char_arr[i]);
+  }
+  HashMapStats stats;
+  fail_flag = fail_flag || HashMapGetStats(h_map, &stats) != 1 ||
+      HashMapGetStats(h_map, NULL) != 0 ||
+      stats.size != BACKEND_TEST_PAIRS || stats.capacity != h_map->capacity;
+  size_t chains = 0;
+  for(size_t i = 0; i < HASH_MAP_STATS_HISTOGRAM && !fail_flag; i++){
+    chains += stats.chain_histogram[i];
+  }
+  int chained = options->backend == HASH_MAP_CHAINED ||
+      options->backend == HASH_MAP_CHAINED_INLINE;
+  //a chain per bucket (or slot); the chained lengths add up to the size,
+  //every pair of an open addressing map has a slot
+  fail_flag = fail_flag || chains != stats.capacity ||
+      stats.chain_histogram[0] != stats.capacity - stats.occupied_buckets ||
+      stats.max_chain < stats.average_chain || stats.average_chain < 1 ||
+      (chained && (size_t) (stats.average_chain * stats.occupied_buckets +
+      0.5) != BACKEND_TEST_PAIRS) ||
+      (!chained && stats.occupied_buckets != BACKEND_TEST_PAIRS) ||
+      (options->seeded_hash && chained && (stats.occupied_buckets != 3 ||
+      stats.max_chain < BACKEND_TEST_PAIRS / 3)) ||
+      //the keys are 1..100 hashed as they are- the swiss table mixes them,
+      //so they do not all start in the first group
+      (!options->seeded_hash && options->backend == HASH_MAP_SWISS &&
+      stats.max_chain > 2);
+#ifdef HASH_MAP_STATS
+  fail_flag = fail_flag || stats.counters.grows == 0 ||
+      stats.counters.shrinks != 0 || stats.counters.rehashed_pairs == 0 ||
+      stats.counters.key_cmps < BACKEND_TEST_PAIRS;
+#endif
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    fail_flag = HashMapErase(h_map, &char_arr[i]) != 1;
+  }
+  fail_flag = fail_flag || HashMapGetStats(h_map, &stats) != 1 ||
+      stats.occupied_buckets != 0 || stats.max_chain != 0 ||
+      stats.chain_histogram[0] != stats.capacity;
+#ifdef HASH_MAP_STATS
+  fail_flag = fail_flag || stats.counters.shrinks == 0;
+#else
+  //the counters are there, but nothing counts
+  fail_flag = fail_flag || stats.counters.grows != 0 ||
+      stats.counters.shrinks != 0 || stats.counters.key_cmps != 0;
+#endif
+  HashMapFree(&h_map);
+  return fail_flag;
+}
+
+/**
+ * the number of pairs CountingPairCpy copied so far
+ */
+size_t pair_copies = 0;
+
+/**
+ * copies a pair like PairCharIntCpy, and counts the copy in pair_copies
+ */
+void *CountingPairCpy(const void *pair) {
+  pair_copies++;
+  return PairCharIntCpy(pair);
+}
+
+int Test23() {
+  HashMapOptions options = {0};
+  int fail_flag = 0;
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE &&
+  !fail_flag; backend++){
+    options.backend = (HashMapBackend) backend;
+    fail_flag = TestResizeMoves(&options);
+  }
+  HashMapOptions incremental = {0};
+  incremental.incremental_resize_step = 4;
+  fail_flag = fail_flag || TestResizeMoves(&incremental);
+  if(fail_flag){
+    fprintf(stderr, "TEST 23: resizing copied pairs\n");
+    return TEST23FAIL;
+  }
+  return SUCCESS;
+}
+
+/**
+ * fills a map, grows it and shrinks it again, and checks only the inserts
+ * copied pairs- resizing moves them
+ * @param options the options of the map
+ * @return 0 upon success, 1 otherwise
+ */
+int TestResizeMoves(const HashMapOptions *options) {
+  char char_arr[BACKEND_TEST_PAIRS];
+  int int_arr[BACKEND_TEST_PAIRS];
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, CountingPairCpy,
+      PairCharIntCmp, PairCharIntFree, options);
+  int fail_flag = !h_map;
+  pair_copies = 0;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    char_arr[i] = (char)(i + 1);
+    int_arr[i] = i;
+    Pair *pair = PairAlloc(&char_arr[i], &int_arr[i], PAIR_FUNCS);
+    fail_flag = HashMapInsert(h_map, pair) != 1;
+    PairFree(&pair);
+  }
+  fail_flag = fail_flag || pair_copies != BACKEND_TEST_PAIRS ||
+      HashMapReserve(h_map, 10 * BACKEND_TEST_PAIRS) != 1;
+  size_t grown = fail_flag ? 0 : h_map->capacity;
+  for(int i = 0; i < BACKEND_TEST_PAIRS - 10 && !fail_flag; i++){
+    fail_flag = HashMapErase(h_map, &char_arr[i]) != 1;
+  }
+  for(int i = BACKEND_TEST_PAIRS - 10; i < BACKEND_TEST_PAIRS && !fail_flag;
+  i++){
+    fail_flag = !HashMapContainsKey(h_map, &char_arr[i]);
+  }
+  fail_flag = fail_flag || HashMapShrinkToFit(h_map) != 1 ||
+      h_map->capacity >= grown || grown < 10 * BACKEND_TEST_PAIRS ||
+      pair_copies != BACKEND_TEST_PAIRS;
+  HashMapFree(&h_map);
+  return fail_flag;
+}
+
+/**
+ * the number of calls to CountingHash and CountingKeyCmp so far
+ */
+size_t hash_calls = 0;
+size_t key_cmp_calls = 0;
+
+/**
+ * hashes a char key to its value times 2^16, and counts the call- every key
+ * lands in the first bucket of a map of up to 2^16 buckets, with a full
+ * hash of its own
+ */
+size_t CountingHash(KeyT key) {
+  hash_calls++;
+  return (size_t)(unsigned char)*(char *)key << 16;
+}
+
+/**
+ * compares char keys like CharKeyCmp, and counts the call
+ */
+int CountingKeyCmp(void *key_1, void *key_2) {
+  key_cmp_calls++;
+  return CharKeyCmp(key_1, key_2);
+}
+
+int Test24() {
+  HashMapOptions options = {0};
+  int fail_flag = TestKeptHashes(&options);
+  options.backend = HASH_MAP_CHAINED_INLINE;
+  fail_flag = fail_flag || TestKeptHashes(&options);
+  if(fail_flag){
+    fprintf(stderr, "TEST 24: the map hashed or compared keys again\n");
+    return TEST24FAIL;
+  }
+  return SUCCESS;
+}
+
+/**
+ * puts all the pairs in one bucket, and checks lookups compare keys only
+ * with their own and resizes never hash a key
+ * @return 0 if passed, 1 otherwise
+ */
+int TestKeptHashes(const HashMapOptions *options) {
+  HashMap *h_map = HashMapAllocWithOptions(CountingHash, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, options);
+  char char_arr[BACKEND_TEST_PAIRS];
+  int int_arr[BACKEND_TEST_PAIRS];
+  int fail_flag = !h_map;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    char_arr[i] = (char)(i + 1);
+    int_arr[i] = i;
+    Pair *pair = PairAlloc(&char_arr[i], &int_arr[i], CharKeyCpy,
+        IntValueCpy, CountingKeyCmp, IntValueCmp, CharKeyFree, IntValueFree);
+    fail_flag = HashMapInsert(h_map, pair) != 1;
+    PairFree(&pair);
+  }
+  //all the pairs in one bucket, but every key is compared only with itself
+  size_t in_bucket = 0;
+  while(!fail_flag && HashMapBucketAt(h_map, 0, in_bucket) != NULL){
+    in_bucket++;
+  }
+  fail_flag = fail_flag || in_bucket != BACKEND_TEST_PAIRS;
+  key_cmp_calls = 0;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    fail_flag = !HashMapContainsKey(h_map, &char_arr[i]);
+  }
+  fail_flag = fail_flag || key_cmp_calls != BACKEND_TEST_PAIRS;
+  //resizing takes the hashes from the buckets
+  hash_calls = 0;
+  fail_flag = fail_flag || HashMapReserve(h_map, 10 * BACKEND_TEST_PAIRS) !=
+      1 || HashMapShrinkToFit(h_map) != 1 || hash_calls != 0;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    fail_flag = HashMapErase(h_map, &char_arr[i]) != 1;
+  }
+  fail_flag = fail_flag || hash_calls != BACKEND_TEST_PAIRS ||
+      h_map->size != 0;
+  HashMapFree(&h_map);
+  return fail_flag;
+}
+
+int Test14() {
+  char char_arr[BACKEND_TEST_PAIRS];
+  int int_arr[BACKEND_TEST_PAIRS];
+  Pair* pair_arr[BACKEND_TEST_PAIRS];
+  for(int i = 0; i < BACKEND_TEST_PAIRS; i++){
+    char_arr[i] = (char)(i + 1);
+    int_arr[i] = i;
+    pair_arr[i] = PairAlloc(&char_arr[i], &int_arr[i], PAIR_FUNCS);
+  }
+
+  //room for all the pairs from the start
+  HashMap *h_map = HashMapAllocWithCapacity(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, BACKEND_TEST_PAIRS);
+  int fail_flag = !h_map || h_map->capacity != 256;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    fail_flag = HashMapInsert(h_map, pair_arr[i]) != 1 ||
+        h_map->capacity != 256;
+  }
+  if(!fail_flag && (HashMapReserve(h_map, 1000) != 1 ||
+  h_map->capacity != 2048 || HashMapReserve(h_map, 10) != 1 ||
+  h_map->capacity != 2048)){
+    fail_flag = 1;
+  }
+  //no capacity holds that many pairs- fails instead of wrapping around
+  if(!fail_flag && (HashMapReserve(h_map, SIZE_MAX / 2) != 0 ||
+  HashMapReserve(h_map, SIZE_MAX) != 0 || h_map->capacity != 2048 ||
+  h_map->size != BACKEND_TEST_PAIRS ||
+  !HashMapContainsKey(h_map, &char_arr[0]))){
+    fail_flag = 1;
+  }
+  HashMapFree(&h_map);
+  HashMapOptions huge = {0};
+  huge.initial_pairs = SIZE_MAX / 2;
+  h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy, PairCharIntCmp,
+      PairCharIntFree, &huge);
+  fail_flag = fail_flag || h_map;
+  huge.initial_pairs = 0;
+  huge.min_capacity = SIZE_MAX;
+  h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy, PairCharIntCmp,
+      PairCharIntFree, &huge);
+  fail_flag = fail_flag || h_map;
+
+  //manual shrinking- erasing everything keeps the capacity
+  HashMapOptions options = {0};
+  options.shrink_policy = HASH_MAP_SHRINK_MANUAL;
+  h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy, PairCharIntCmp,
+      PairCharIntFree, &options);
+  fail_flag = fail_flag || !h_map;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    fail_flag = HashMapInsert(h_map, pair_arr[i]) != 1;
+  }
+  for(int i = 0; i < BACKEND_TEST_PAIRS - 1 && !fail_flag; i++){
+    fail_flag = HashMapErase(h_map, &char_arr[i]) != 1;
+  }
+  if(!fail_flag && (h_map->capacity != 256 || HashMapShrinkToFit(h_map) != 1
+  || h_map->capacity != 2 || !HashMapContainsKey(h_map,
+      &char_arr[BACKEND_TEST_PAIRS - 1]))){
+    fail_flag = 1;
+  }
+  HashMapFree(&h_map);
+
+  //a pinned minimal capacity
+  options.shrink_policy = HASH_MAP_SHRINK_ON_ERASE;
+  options.min_capacity = 60;
+  h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy, PairCharIntCmp,
+      PairCharIntFree, &options);
+  fail_flag = fail_flag || !h_map || h_map->capacity != 64;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    fail_flag = HashMapInsert(h_map, pair_arr[i]) != 1;
+  }
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    fail_flag = HashMapErase(h_map, &char_arr[i]) != 1;
+  }
+  if(!fail_flag && h_map->capacity != 64){
+    fail_flag = 1;
+  }
+  HashMapClear(h_map);
+  if(!fail_flag && h_map->capacity != 64){
+    fail_flag = 1;
+  }
+  HashMapFree(&h_map);
+
+  for(int i = 0; i < BACKEND_TEST_PAIRS; i++){
+    PairCharIntFree((void*)&pair_arr[i]);
+  }
+  if(fail_flag){
+    fprintf(stderr, "TEST 14: wrong capacity\n");
+    return TEST14FAIL;
+  }
+  return SUCCESS;
+}
+
+int Test13() {
+  HashMapOptions options = {0};
+  for(int backend = HASH_MAP_CHAINED; backend <= HASH_MAP_CHAINED_INLINE; backend++){
+    options.backend = (HashMapBackend) backend;
+    if(TestBatch(&options)){
+      return TEST13FAIL;
+    }
+  }
+  //a batch that comes while an incremental grow migrates still keeps the
+  //load factor- its inserts grow the map one by one
+  options.backend = HASH_MAP_CHAINED;
+  options.incremental_resize_step = 1;
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, &options);
+  char char_arr[BACKEND_TEST_PAIRS];
+  Pair* pair_arr[BACKEND_TEST_PAIRS];
+  for(int i = 0; i < BACKEND_TEST_PAIRS; i++){
+    char_arr[i] = (char)(i + 1);
+    pair_arr[i] = PairAlloc(&char_arr[i], &i, PAIR_FUNCS);
+  }
+  //the 13th pair starts a grow from 16 to 32 buckets
+  int fail_flag = !h_map;
+  for(int i = 0; i < 13 && !fail_flag; i++){
+    fail_flag = HashMapInsert(h_map, pair_arr[i]) != 1;
+  }
+  fail_flag = fail_flag || HashMapInsertBatch(h_map, pair_arr + 13,
+      BACKEND_TEST_PAIRS - 13) != 1 || h_map->size != BACKEND_TEST_PAIRS ||
+      HashMapGetLoadFactor(h_map) > HASH_MAP_MAX_LOAD_FACTOR;
+  for(int i = 0; i < BACKEND_TEST_PAIRS; i++){
+    PairCharIntFree((void*)&pair_arr[i]);
+  }
+  HashMapFree(&h_map);
+  return fail_flag ? TEST13FAIL : SUCCESS;
+}
+
+/**
+ * inserts BACKEND_TEST_PAIRS pairs (half of them twice) with one batch and
+ * looks them up, together with keys that are not in the map, with another.
+ * @return 0 if everything worked, 1 otherwise
+ */
+int TestBatch(const HashMapOptions *options) {
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, options);
+  if(!h_map){
+    fprintf(stderr, "Failed to allocate hash map\n");
+    return 1;
+  }
+  char char_arr[2 * BACKEND_TEST_PAIRS];
+  int int_arr[BACKEND_TEST_PAIRS];
+  Pair* pair_arr[BACKEND_TEST_PAIRS + BACKEND_TEST_PAIRS / 2];
+  for(int i = 0; i < BACKEND_TEST_PAIRS; i++){
+    char_arr[i] = (char)(i + 1);
+    char_arr[BACKEND_TEST_PAIRS + i] = (char)(-i - 1);
+    int_arr[i] = i * 10;
+    pair_arr[i] = PairAlloc(&char_arr[i], &int_arr[i], PAIR_FUNCS);
+  }
+  //the second pair of every key carries the value of the next key
+  for(int i = 0; i < BACKEND_TEST_PAIRS / 2; i++){
+    pair_arr[BACKEND_TEST_PAIRS + i] = PairAlloc(&char_arr[i],
+        &int_arr[i + 1], PAIR_FUNCS);
+  }
+
+  int fail_flag = HashMapInsertBatch(h_map, pair_arr, BACKEND_TEST_PAIRS +
+      BACKEND_TEST_PAIRS / 2) != 1 || h_map->size != BACKEND_TEST_PAIRS;
+  KeyT keys[2 * BACKEND_TEST_PAIRS];
+  ValueT values[2 * BACKEND_TEST_PAIRS];
+  for(int i = 0; i < 2 * BACKEND_TEST_PAIRS; i++){
+    keys[i] = &char_arr[i];
+  }
+  if(!fail_flag && HashMapAtBatch(h_map, keys, 2 * BACKEND_TEST_PAIRS,
+      values) != BACKEND_TEST_PAIRS){
+    fail_flag = 1;
+  }
+  for(int i = 0; i < 2 * BACKEND_TEST_PAIRS && !fail_flag; i++){
+    int expected = i < BACKEND_TEST_PAIRS / 2 ? int_arr[i + 1] :
+        i < BACKEND_TEST_PAIRS ? int_arr[i] : 0;
+    if(i < BACKEND_TEST_PAIRS ? !values[i] || *(int *)values[i] != expected :
+    values[i] != NULL){
+      fprintf(stderr, "wrong batch value for key #%d\n", i);
+      fail_flag = 1;
+    }
+  }
+
+  for(int i = 0; i < BACKEND_TEST_PAIRS + BACKEND_TEST_PAIRS / 2; i++){
+    PairCharIntFree((void*)&pair_arr[i]);
+  }
+  HashMapFree(&h_map);
+  return fail_flag;
+}
+
+int Test9() {
+  IntIntMap *map = IntIntMapAlloc();
+  if(!map){
+    fprintf(stderr, "TEST 9: Failed to allocate map\n");
+    return TEST9FAIL;
+  }
+  int fail_flag = 0;
+  for(int i = 0; i < 1000 && !fail_flag; i++){
+    fail_flag = IntIntMapInsert(map, i * 16, i) != 1;
+  }
+  if(fail_flag || map->size != 1000 || map->capacity != 2048){
+    fprintf(stderr, "TEST 9: insertion failed or size/capacity incorrect\n");
+    fail_flag = 1;
+  }
+  for(int i = 0; i < 1000 && !fail_flag; i++){
+    int *value = IntIntMapAt(map, i * 16);
+    fail_flag = !value || *value != i || IntIntMapContainsKey(map, i * 16 + 1);
+  }
+  for(int i = 0; i < 1000 && !fail_flag; i += 2){
+    fail_flag = IntIntMapErase(map, i * 16) != 1;
+  }
+  for(int i = 0; i < 1000 && !fail_flag; i++){
+    fail_flag = IntIntMapContainsKey(map, i * 16) != i % 2;
+  }
+  if(!fail_flag && (IntIntMapInsert(map, 16, -1) != 1 ||
+  *IntIntMapAt(map, 16) != -1 || map->size != 500 ||
+  map->capacity != 1024)){
+    fail_flag = 1;
+  }
+  IntIntMapClear(map);
+  if(!fail_flag && (map->size != 0 || IntIntMapContainsKey(map, 16))){
+    fail_flag = 1;
+  }
+  //keys that differ only above the mask- mixed, they start all over the table
+  for(int i = 0; i < 1000 && !fail_flag; i++){
+    fail_flag = IntIntMapInsert(map, i << 16, i) != 1;
+  }
+  size_t mask = map->capacity - 1, longest = 0;
+  for(size_t i = 0; i < map->capacity && !fail_flag; i++){
+    size_t dist = (i - (map->slots[i].hash & mask)) & mask;
+    longest = map->slots[i].full && dist > longest ? dist : longest;
+  }
+  fail_flag = fail_flag || longest > 32;
+  IntIntMapFree(&map);
+  if(fail_flag){
+    fprintf(stderr, "TEST 9: typed map returned wrong results\n");
+    return TEST9FAIL;
+  }
+  return SUCCESS;
+}
+
+int Test8() {
+  HashMapOptions options = {0};
+  options.backend = HASH_MAP_SWISS;
+  return TestOptions(&options) ? TEST8FAIL : SUCCESS;
+}
+
+/**
+ * runs the whole api on a map with the given options: inserts
+ * BACKEND_TEST_PAIRS pairs, checks them, erases half of them, replaces a
+ * value and clears the map.
+ * @return 0 if everything worked, 1 otherwise
+ */
+int TestOptions(const HashMapOptions *options) {
+  HashMap *h_map = HashMapAllocWithOptions(HashChar, PairCharIntCpy,
+      PairCharIntCmp, PairCharIntFree, options);
+  if(!h_map){
+    fprintf(stderr, "Failed to allocate hash map\n");
+    return 1;
+  }
+
+  char char_arr[BACKEND_TEST_PAIRS];
+  int int_arr[BACKEND_TEST_PAIRS];
+  Pair* pair_arr[BACKEND_TEST_PAIRS];
+  for(int i = 0; i < BACKEND_TEST_PAIRS; i++){
+    char_arr[i] = (char)(i + 1);
+    int_arr[i] = i * 10;
+    pair_arr[i] = PairAlloc(&char_arr[i], &int_arr[i], PAIR_FUNCS);
+  }
+
+  int fail_flag = 0;
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    fail_flag = HashMapInsert(h_map, pair_arr[i]) != 1;
+  }
+  if(fail_flag || h_map->size != BACKEND_TEST_PAIRS || h_map->capacity !=
+  256){
+    fprintf(stderr, "insertion failed or size/capacity incorrect\n");
+    fail_flag = 1;
+  }
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    int *value = HashMapAt(h_map, &char_arr[i]);
+    if(!value || *value != int_arr[i]){
+      fprintf(stderr, "wrong value for key #%d\n", i);
+      fail_flag = 1;
+    }
+  }
+
+  //erasing the even keys
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i += 2){
+    fail_flag = HashMapErase(h_map, &char_arr[i]) != 1;
+  }
+  for(int i = 0; i < BACKEND_TEST_PAIRS && !fail_flag; i++){
+    if(HashMapContainsKey(h_map, &char_arr[i]) != i % 2 ||
+    HashMapContainsValue(h_map, &int_arr[i]) != i % 2){
+      fprintf(stderr, "key #%d is (or is not) in the map after erase\n", i);
+      fail_flag = 1;
+    }
+  }
+  if(!fail_flag && (h_map->size != BACKEND_TEST_PAIRS / 2 ||
+  h_map->capacity != 128)){
+    fprintf(stderr, "size/capacity incorrect after erase\n");
+    fail_flag = 1;
+  }
+
+  //replacing the value of an existing key
+  int new_val = -1;
+  Pair *same_key_pair = PairAlloc(&char_arr[1], &new_val, PAIR_FUNCS);
+  if(!fail_flag && (HashMapInsert(h_map, same_key_pair) != 1 ||
+  *(int *)HashMapAt(h_map, &char_arr[1]) != new_val ||
+  h_map->size != BACKEND_TEST_PAIRS / 2)){
+    fprintf(stderr, "replacing a value failed\n");
+    fail_flag = 1;
+  }
+
+  HashMapClear(h_map);
+  if(!fail_flag && (h_map->size != 0 || HashMapContainsKey(h_map,
+      &char_arr[1]))){
+    fprintf(stderr, "map is not empty after clear\n");
+    fail_flag = 1;
+  }
+
+  PairCharIntFree((void*)&same_key_pair);
+  for(int i = 0; i < BACKEND_TEST_PAIRS; i++){
+    PairCharIntFree((void*)&pair_arr[i]);
+  }
+  HashMapFree(&h_map);
+  return fail_flag;
+}
+
 int Test6() {
   HashMap *h_map = HashMapAlloc(HashChar, PairCharIntCpy, PairCharIntCmp,
                                 PairCharIntFree);
@@ -718,10 +2154,9 @@ int Test2() {
 
   int fail_flag = 0;
   size_t index = (h_map->hash_func(same_key_pair->key)) & (h_map->capacity - 1);
-  Vector *contains_key = h_map->buckets[index];
-  if(contains_key){
-    for(size_t i = 0; i < contains_key->size; i++){
-      Pair *cur_pair = (Pair*)contains_key->data[i];
+  Pair *cur_pair = HashMapBucketAt(h_map, index, 0);
+  if(cur_pair){
+    for(size_t i = 0; cur_pair; cur_pair = HashMapBucketAt(h_map, index, ++i)){
       if(cur_pair->key_cmp(cur_pair->key, same_key_pair->key)){
         if(cur_pair->value_cmp(cur_pair->value, same_key_pair->value)){
           break;
@@ -49,6 +49,34 @@ typedef struct Pair {
   PairValueFree value_free;
 } Pair;
 
+/**
+ * @struct PairTraits - the functions of the keys and values of a container.
+ * A container that keeps the functions once (instead of once in every pair)
+ * stores its pairs as KeyValue.
+ * @param key_cpy, value_cpy - copy functions for key and value.
+ * @param key_cmp, value_cmp - compare functions for key and value.
+ * @param key_free, value_free - free functions for key and value.
+ */
+typedef struct PairTraits {
+  PairKeyCpy key_cpy;
+  PairValueCpy value_cpy;
+  PairKeyCmp key_cmp;
+  PairValueCmp value_cmp;
+  PairKeyFree key_free;
+  PairValueFree value_free;
+} PairTraits;
+
+/**
+ * @struct KeyValue - a pair '''{key: value}''' without functions, its
+ * functions are the PairTraits of the container holding it.
+ * Starts with the same fields as Pair.
+ * @param key, value - the key and value.
+ */
+typedef struct KeyValue {
+  KeyT key;
+  ValueT value;
+} KeyValue;
+
 /**
  * Allocates dynamically a new pair.
  * @param key, value - the key and value.
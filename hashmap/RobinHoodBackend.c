@@ -0,0 +1,251 @@
+/**
+ * @file RobinHoodBackend.c
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief the HASH_MAP_ROBIN_HOOD storage engine of HashMap.h - one flat
+ * array of (hash, pair) slots with linear probing.
+ *
+ * Robin Hood insertion: a pair that is further from its home slot than the
+ * pair occupying the slot takes the slot, and the displaced pair keeps
+ * probing. It keeps probe lengths short and lets a miss stop as soon as it
+ * meets a pair that is closer to its home than the probe is.
+ * Erasing shifts the rest of the cluster one slot back (backward shift
+ * deletion), so the table never holds tombstones.
+ *
+ * @section LICENSE
+ * This program is private and was made for the 2020 67315 course
+ */
+
+// ------------------------------ includes ------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "HashMapBackend.h"
+
+// -------------------------- const definitions -------------------------
+/**
+ * @def SLOT_IS_EMPTY
+ * @brief checks if a slot holds no pair
+ */
+#define SLOT_IS_EMPTY(slot) ((slot).pair == NULL)
+
+/**
+ * @struct RobinHoodState
+ * The storage of a HASH_MAP_ROBIN_HOOD map (its backend_state).
+ * @param slots the table, capacity slots.
+ */
+typedef struct RobinHoodState {
+  HashMapSlot *slots;
+} RobinHoodState;
+
+/**
+ * @def STATE
+ * @brief the storage of the map (see RobinHoodState)
+ */
+#define STATE(hash_map) ((RobinHoodState *) (hash_map)->backend_state)
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * calculates how far a slot is from the home slot of the hash it holds
+ * @param hash the hash kept in the slot
+ * @param index the index of the slot
+ * @param mask capacity - 1
+ * @return the probe distance of the slot
+ */
+static size_t ProbeDistance(size_t hash, size_t index, size_t mask);
+
+/**
+ * places a slot in the table, displacing richer slots on the way
+ * @param slots the table
+ * @param mask capacity - 1
+ * @param to_place the slot to place (hash and pair)
+ */
+static void PlaceSlot(HashMapSlot *slots, size_t mask, HashMapSlot to_place);
+
+/**
+ * finds the index of the slot holding the given key
+ * @param hash_map HashMap struct object
+ * @param key the key to look for
+ * @param hash the hash of key
+ * @param p_index output - the index of the slot
+ * @return 1 if found, 0 otherwise
+ */
+static int FindIndex(HashMap *hash_map, KeyT key, size_t hash,
+    size_t *p_index);
+
+static int RobinHoodInit(HashMap *hash_map, size_t capacity);
+static void RobinHoodDestroy(HashMap *hash_map);
+static Pair **RobinHoodFind(HashMap *hash_map, KeyT key, size_t hash);
+static int RobinHoodInsert(HashMap *hash_map, Pair *pair, size_t hash);
+static int RobinHoodErase(HashMap *hash_map, KeyT key, size_t hash);
+static int RobinHoodResize(HashMap *hash_map, size_t new_capacity);
+static Pair *RobinHoodNext(HashMap *hash_map, size_t *bucket, size_t *pos);
+static void RobinHoodPrefetch(const HashMap *hash_map, size_t hash);
+static void RobinHoodClear(HashMap *hash_map);
+static void RobinHoodStats(const HashMap *hash_map, HashMapStats *stats);
+
+const HashMapBackendOps RobinHoodBackendOps = {
+    RobinHoodInit, RobinHoodDestroy, RobinHoodFind, RobinHoodInsert,
+    RobinHoodErase, RobinHoodResize, RobinHoodNext, RobinHoodPrefetch,
+    RobinHoodClear, RobinHoodStats
+};
+
+static size_t ProbeDistance(size_t hash, size_t index, size_t mask) {
+  return (index - (hash & mask)) & mask;
+}
+
+static void PlaceSlot(HashMapSlot *slots, size_t mask, HashMapSlot to_place) {
+  size_t index = to_place.hash & mask;
+  size_t dist = 0;
+  while (!SLOT_IS_EMPTY(slots[index])) {
+    size_t cur_dist = ProbeDistance(slots[index].hash, index, mask);
+    if (cur_dist < dist) {
+      HashMapSlot tmp = slots[index];
+      slots[index] = to_place;
+      to_place = tmp;
+      dist = cur_dist;
+    }
+    index = (index + 1) & mask;
+    dist++;
+  }
+  slots[index] = to_place;
+}
+
+static int FindIndex(HashMap *hash_map, KeyT key, size_t hash,
+    size_t *p_index) {
+  const HashMapSlot *slots = STATE(hash_map)->slots;
+  size_t mask = hash_map->capacity - 1;
+  size_t index = hash & mask;
+  for (size_t dist = 0; dist < hash_map->capacity; dist++) {
+    const HashMapSlot *slot = &slots[index];
+    if (SLOT_IS_EMPTY(*slot) ||
+        ProbeDistance(slot->hash, index, mask) < dist) {
+      return FAIL;
+    }
+    if (slot->hash == hash && ENTRY_HAS_KEY(hash_map, slot->pair, key)) {
+      *p_index = index;
+      return SUCCESS;
+    }
+    index = (index + 1) & mask;
+  }
+  return FAIL;
+}
+
+static int RobinHoodInit(HashMap *hash_map, size_t capacity) {
+  CHECK_ERROR(capacity != 0, FAIL)
+  RobinHoodState *state = malloc(sizeof(RobinHoodState));
+  CHECK_ERROR(state, FAIL)
+  state->slots = calloc(capacity, sizeof(HashMapSlot));
+  if (!state->slots) {
+    free(state);
+    return FAIL;
+  }
+  hash_map->backend_state = state;
+  hash_map->capacity = capacity;
+  return SUCCESS;
+}
+
+static void RobinHoodDestroy(HashMap *hash_map) {
+  RobinHoodState *state = STATE(hash_map);
+  CHECK_ERROR(state, NO_RETURN_VALUE)
+  RobinHoodClear(hash_map);
+  free(state->slots);
+  free(state);
+  hash_map->backend_state = NULL;
+}
+
+static void RobinHoodClear(HashMap *hash_map) {
+  HashMapSlot *slots = STATE(hash_map)->slots;
+  for (size_t i = 0; i < hash_map->capacity && !ENTRIES_IN_ARENA(hash_map);
+       i++) {
+    if (!SLOT_IS_EMPTY(slots[i])) {
+      HashMapEntryFree(hash_map, &slots[i].pair);
+    }
+  }
+  memset(slots, 0, hash_map->capacity * sizeof(HashMapSlot));
+}
+
+static Pair **RobinHoodFind(HashMap *hash_map, KeyT key, size_t hash) {
+  size_t index = 0;
+  CHECK_ERROR(FindIndex(hash_map, key, hash, &index), NULL)
+  return &STATE(hash_map)->slots[index].pair;
+}
+
+static int RobinHoodInsert(HashMap *hash_map, Pair *pair, size_t hash) {
+  HashMapSlot to_place = {hash, HashMapEntryCopy(hash_map, pair)};
+  CHECK_ERROR(to_place.pair, FAIL)
+  PlaceSlot(STATE(hash_map)->slots, hash_map->capacity - 1, to_place);
+  return SUCCESS;
+}
+
+static int RobinHoodErase(HashMap *hash_map, KeyT key, size_t hash) {
+  HashMapSlot *slots = STATE(hash_map)->slots;
+  size_t index = 0;
+  CHECK_ERROR(FindIndex(hash_map, key, hash, &index), FAIL)
+  HashMapEntryFree(hash_map, &slots[index].pair);
+
+  //backward shift: pull the rest of the cluster one slot closer to home
+  size_t mask = hash_map->capacity - 1;
+  size_t next = (index + 1) & mask;
+  while (!SLOT_IS_EMPTY(slots[next]) &&
+      ProbeDistance(slots[next].hash, next, mask) != 0) {
+    slots[index] = slots[next];
+    index = next;
+    next = (next + 1) & mask;
+  }
+  slots[index].pair = NULL;
+  slots[index].hash = 0;
+  return SUCCESS;
+}
+
+static int RobinHoodResize(HashMap *hash_map, size_t new_capacity) {
+  CHECK_ERROR(new_capacity != 0, FAIL)
+  RobinHoodState *state = STATE(hash_map);
+  HashMapSlot *new_slots = calloc(new_capacity, sizeof(HashMapSlot));
+  CHECK_ERROR(new_slots, FAIL)
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    if (!SLOT_IS_EMPTY(state->slots[i])) {
+      PlaceSlot(new_slots, new_capacity - 1, state->slots[i]);
+    }
+  }
+  free(state->slots);
+  state->slots = new_slots;
+  hash_map->capacity = new_capacity;
+  return SUCCESS;
+}
+
+static Pair *RobinHoodNext(HashMap *hash_map, size_t *bucket, size_t *pos) {
+  HashMapSlot *slots = STATE(hash_map)->slots;
+  size_t mask = hash_map->capacity - 1;
+  if (*pos == 0) {
+    //the walk starts at an empty slot (pos keeps its index + 1): erasing the
+    //pair just returned only pulls pairs the walk did not reach yet
+    size_t start = 0;
+    while (start < mask && !SLOT_IS_EMPTY(slots[start])) {
+      start++;
+    }
+    *pos = start + 1;
+  }
+  for (; *bucket < hash_map->capacity; (*bucket)++) {
+    HashMapSlot *slot = &slots[(*pos - 1 + *bucket) & mask];
+    if (!SLOT_IS_EMPTY(*slot)) {
+      (*bucket)++;
+      return slot->pair;
+    }
+  }
+  return NULL;
+}
+
+static void RobinHoodStats(const HashMap *hash_map, HashMapStats *stats) {
+  const HashMapSlot *slots = STATE(hash_map)->slots;
+  size_t mask = hash_map->capacity - 1;
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    const HashMapSlot *slot = &slots[i];
+    HashMapStatsAddChain(stats, SLOT_IS_EMPTY(*slot) ? 0 :
+                         ProbeDistance(slot->hash, i, mask) + 1);
+  }
+}
+
+static void RobinHoodPrefetch(const HashMap *hash_map, size_t hash) {
+  HASH_MAP_PREFETCH(&STATE(hash_map)->slots[hash & (hash_map->capacity - 1)]);
+}
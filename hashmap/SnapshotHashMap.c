@@ -0,0 +1,261 @@
+/**
+ * @file SnapshotHashMap.c
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief implementation for SnapshotHashMap.h
+ *
+ * Every access to current, epoch and the reader slots is a sequentially
+ * consistent atomic (the __atomic builtins of gcc and clang). A reader
+ * stores its epoch to its slot before it loads current, a writer stores
+ * current before it scans the slots, so a writer that sees a slot idle (or
+ * newer than a retired version) knows the reader will load the newer
+ * version.
+ *
+ * @section LICENSE
+ * This program is private and was made for the 2020 67315 course
+ */
+
+// ------------------------------ includes ------------------------------
+#include <stdlib.h>
+#include "SnapshotHashMap.h"
+#include "HashMapBackend.h"
+
+// -------------------------- const definitions -------------------------
+/**
+ * @def CACHE_LINE
+ * @brief bytes kept between neighbour reader slots, so readers announcing
+ * their epochs do not fight over one cache line
+ */
+#define CACHE_LINE 64
+
+/**
+ * @def EPOCH_IDLE
+ * @brief the epoch of a reader slot that is not reading
+ */
+#define EPOCH_IDLE 0
+
+/**
+ * @def ATOMIC_LOAD, ATOMIC_STORE
+ * @brief sequentially consistent load and store
+ */
+#define ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_SEQ_CST)
+
+/**
+ * @struct SnapshotReader
+ * @param in_use 1 if a thread registered the slot.
+ * @param epoch the epoch the slot's reader started reading in, EPOCH_IDLE if
+ * it is not reading.
+ * @param padding keeps the next slot off this cache line.
+ */
+struct SnapshotReader {
+  int in_use;
+  size_t epoch;
+  char padding[CACHE_LINE];
+};
+
+/**
+ * @struct SnapshotRetired
+ * A replaced version waiting for its readers to finish.
+ * @param version the replaced version.
+ * @param epoch the epoch it was replaced in.
+ * @param next the version retired before it.
+ */
+struct SnapshotRetired {
+  HashMap *version;
+  size_t epoch;
+  struct SnapshotRetired *next;
+};
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * publishes a new version and retires the current one (writer lock held)
+ * @param map SnapshotHashMap struct object
+ * @param version the new version
+ * @return 1 upon success, 0 otherwise (the new version is not published)
+ */
+static int Publish(SnapshotHashMap *map, HashMap *version);
+
+/**
+ * frees the retired versions no reader may still read (writer lock held)
+ * @param map SnapshotHashMap struct object
+ */
+static void Reclaim(SnapshotHashMap *map);
+
+/**
+ * update function of SnapshotHashMapInsert
+ */
+static int InsertUpdate(HashMap *version, void *pair);
+
+/**
+ * update function of SnapshotHashMapErase
+ */
+static int EraseUpdate(HashMap *version, void *key);
+
+SnapshotHashMap *SnapshotHashMapAlloc(HashFunc hash_func,
+                                      HashMapPairCpy pair_cpy,
+                                      HashMapPairCmp pair_cmp,
+                                      HashMapPairFree pair_free,
+                                      const HashMapOptions *options) {
+  CHECK_ERROR(!options || options->incremental_resize_step == 0, NULL)
+  //versions are copied and freed while readers still hold older ones, and
+  //an arena is not thread safe
+  CHECK_ERROR(!options || !options->arena, NULL)
+  SnapshotHashMap *map = malloc(sizeof(SnapshotHashMap));
+  CHECK_ERROR(map, NULL)
+  map->current = HashMapAllocWithOptions(hash_func, pair_cpy, pair_cmp,
+                                         pair_free, options);
+  map->readers = calloc(SNAPSHOT_HASH_MAP_MAX_READERS,
+                        sizeof(SnapshotReader));
+  if (!map->current || !map->readers ||
+      pthread_mutex_init(&map->writer_lock, NULL) != 0) {
+    HashMapFree(&map->current);
+    free(map->readers);
+    free(map);
+    return NULL;
+  }
+  map->epoch = EPOCH_IDLE + 1;
+  map->retired = NULL;
+  return map;
+}
+
+void SnapshotHashMapFree(SnapshotHashMap **p_map) {
+  CHECK_ERROR(p_map && (*p_map), NO_RETURN_VALUE)
+  SnapshotHashMap *map = *p_map;
+  while (map->retired) {
+    struct SnapshotRetired *next = map->retired->next;
+    HashMapFree(&map->retired->version);
+    free(map->retired);
+    map->retired = next;
+  }
+  HashMapFree(&map->current);
+  free(map->readers);
+  pthread_mutex_destroy(&map->writer_lock);
+  free(map);
+  *p_map = NULL;
+}
+
+SnapshotReader *SnapshotHashMapRegisterReader(SnapshotHashMap *map) {
+  CHECK_ERROR(map, NULL)
+  for (size_t i = 0; i < SNAPSHOT_HASH_MAP_MAX_READERS; i++) {
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&map->readers[i].in_use, &expected, 1,
+                                    0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      ATOMIC_STORE(&map->readers[i].epoch, EPOCH_IDLE);
+      return &map->readers[i];
+    }
+  }
+  return NULL;
+}
+
+void SnapshotHashMapUnregisterReader(SnapshotHashMap *map,
+                                     SnapshotReader **p_reader) {
+  CHECK_ERROR(map && p_reader && (*p_reader), NO_RETURN_VALUE)
+  ATOMIC_STORE(&(*p_reader)->epoch, EPOCH_IDLE);
+  ATOMIC_STORE(&(*p_reader)->in_use, 0);
+  *p_reader = NULL;
+}
+
+HashMap *SnapshotHashMapReadBegin(SnapshotHashMap *map,
+                                  SnapshotReader *reader) {
+  CHECK_ERROR(map && reader, NULL)
+  ATOMIC_STORE(&reader->epoch, ATOMIC_LOAD(&map->epoch));
+  return ATOMIC_LOAD(&map->current);
+}
+
+void SnapshotHashMapReadEnd(SnapshotReader *reader) {
+  CHECK_ERROR(reader, NO_RETURN_VALUE)
+  ATOMIC_STORE(&reader->epoch, EPOCH_IDLE);
+}
+
+int SnapshotHashMapAt(SnapshotHashMap *map, SnapshotReader *reader, KeyT key,
+                      HashMapValueVisitor visit, void *arg) {
+  HashMap *version = SnapshotHashMapReadBegin(map, reader);
+  CHECK_ERROR(version, FAIL)
+  ValueT value = HashMapAt(version, key);
+  if (value && visit) {
+    visit(value, arg);
+  }
+  SnapshotHashMapReadEnd(reader);
+  return value != NULL;
+}
+
+int SnapshotHashMapContainsKey(SnapshotHashMap *map, SnapshotReader *reader,
+                               KeyT key) {
+  return SnapshotHashMapAt(map, reader, key, NULL, NULL);
+}
+
+size_t SnapshotHashMapGetSize(SnapshotHashMap *map, SnapshotReader *reader) {
+  HashMap *version = SnapshotHashMapReadBegin(map, reader);
+  CHECK_ERROR(version, 0)
+  size_t size = version->size;
+  SnapshotHashMapReadEnd(reader);
+  return size;
+}
+
+int SnapshotHashMapUpdate(SnapshotHashMap *map, SnapshotUpdateFunc update,
+                          void *arg) {
+  CHECK_ERROR(map && update, FAIL)
+  CHECK_ERROR(pthread_mutex_lock(&map->writer_lock) == 0, FAIL)
+  HashMap *version = HashMapCopy(map->current);
+  int result = version && update(version, arg) && Publish(map, version);
+  if (!result) {
+    HashMapFree(&version);
+  }
+  Reclaim(map);
+  pthread_mutex_unlock(&map->writer_lock);
+  return result;
+}
+
+static int InsertUpdate(HashMap *version, void *pair) {
+  return HashMapInsert(version, (Pair *) pair);
+}
+
+int SnapshotHashMapInsert(SnapshotHashMap *map, Pair *pair) {
+  CHECK_ERROR(pair, FAIL)
+  return SnapshotHashMapUpdate(map, InsertUpdate, pair);
+}
+
+static int EraseUpdate(HashMap *version, void *key) {
+  return HashMapErase(version, key);
+}
+
+int SnapshotHashMapErase(SnapshotHashMap *map, KeyT key) {
+  CHECK_ERROR(key, FAIL)
+  return SnapshotHashMapUpdate(map, EraseUpdate, key);
+}
+
+static int Publish(SnapshotHashMap *map, HashMap *version) {
+  struct SnapshotRetired *retired = malloc(sizeof(struct SnapshotRetired));
+  CHECK_ERROR(retired, FAIL)
+  retired->version = map->current;
+  ATOMIC_STORE(&map->current, version);
+  //readers that announce a newer epoch are sure to load the new version
+  retired->epoch = ATOMIC_LOAD(&map->epoch);
+  ATOMIC_STORE(&map->epoch, retired->epoch + 1);
+  retired->next = map->retired;
+  map->retired = retired;
+  return SUCCESS;
+}
+
+static void Reclaim(SnapshotHashMap *map) {
+  size_t oldest_reader = (size_t) -1;
+  for (size_t i = 0; i < SNAPSHOT_HASH_MAP_MAX_READERS; i++) {
+    size_t reader_epoch = ATOMIC_LOAD(&map->readers[i].epoch);
+    if (reader_epoch != EPOCH_IDLE && reader_epoch < oldest_reader) {
+      oldest_reader = reader_epoch;
+    }
+  }
+  struct SnapshotRetired **p_cur = &map->retired;
+  while (*p_cur) {
+    struct SnapshotRetired *cur = *p_cur;
+    if (cur->epoch < oldest_reader) {
+      *p_cur = cur->next;
+      HashMapFree(&cur->version);
+      free(cur);
+    } else {
+      p_cur = &cur->next;
+    }
+  }
+}
@@ -0,0 +1,190 @@
+/**
+ * @file SnapshotHashMap.h
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief a hash map for maps that are read all the time and written rarely.
+ *
+ * Readers never lock and never wait: a lookup reads the pointer to the
+ * current version of the map (an ordinary HashMap that is never changed
+ * once published) and looks the key up in it. A writer (writers are
+ * serialized by a mutex) copies the current version, changes the copy and
+ * publishes it with an atomic store, so the cost of a write is a copy of the
+ * whole map - batch changes with SnapshotHashMapUpdate.
+ *
+ * The replaced versions are freed with epoch based reclamation: every reader
+ * thread registers once and gets a reader slot, a lookup announces the epoch
+ * it started in on its slot, and a version retired in some epoch is freed
+ * only after no reader announces that epoch (or an older one).
+ *
+ * Example:
+ *   SnapshotReader *reader = SnapshotHashMapRegisterReader(map);
+ *   SnapshotHashMapAt(map, reader, key, visit, arg);
+ *   SnapshotHashMapUnregisterReader(map, &reader);
+ */
+
+#ifndef SNAPSHOTHASHMAP_H_
+#define SNAPSHOTHASHMAP_H_
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "HashMap.h"
+#include "ConcurrentHashMap.h"
+
+/**
+ * @def SNAPSHOT_HASH_MAP_MAX_READERS
+ * The maximal number of reader threads registered at the same time.
+ */
+#define SNAPSHOT_HASH_MAP_MAX_READERS 128UL
+
+/**
+ * @typedef SnapshotReader
+ * The reader slot of one thread (see SnapshotHashMapRegisterReader).
+ */
+typedef struct SnapshotReader SnapshotReader;
+
+/**
+ * @typedef SnapshotUpdateFunc
+ * Changes the new version of the map (any HashMap function but HashMapFree)
+ * with the argument given to SnapshotHashMapUpdate.
+ * Returns 1 to publish the new version, 0 to throw it away.
+ */
+typedef int (*SnapshotUpdateFunc)(HashMap *, void *);
+
+struct SnapshotRetired;
+
+/**
+ * @struct SnapshotHashMap
+ * @param current the published version (read and written atomically).
+ * @param epoch the global epoch, advanced by every published version.
+ * @param readers the reader slots.
+ * @param retired the replaced versions not freed yet.
+ * @param writer_lock serializes the writers.
+ */
+typedef struct SnapshotHashMap {
+  HashMap *current;
+  size_t epoch;
+  SnapshotReader *readers;
+  struct SnapshotRetired *retired;
+  pthread_mutex_t writer_lock;
+} SnapshotHashMap;
+
+/**
+ * Allocates dynamically new snapshot hash map element.
+ * @param hash_func a function which "hashes" keys.
+ * @param pair_cpy a function which copies pairs.
+ * @param pair_cmp a function which compares pairs.
+ * @param pair_free a function which frees pairs.
+ * @param options the settings of the versions, NULL for the defaults
+ * (incremental_resize_step is not supported, its lookups move pairs, and
+ * neither is an arena, which is not thread safe).
+ * @return pointer to dynamically allocated SnapshotHashMap.
+ * @if_fail return NULL.
+ */
+SnapshotHashMap *SnapshotHashMapAlloc(
+    HashFunc hash_func, HashMapPairCpy pair_cpy,
+    HashMapPairCmp pair_cmp, HashMapPairFree pair_free,
+    const HashMapOptions *options);
+
+/**
+ * Frees a snapshot hash map, all its versions and reader slots. No other
+ * thread may use the map during or after the call.
+ * @param p_map pointer to dynamically allocated pointer to the map.
+ */
+void SnapshotHashMapFree(SnapshotHashMap **p_map);
+
+/**
+ * Gives the calling thread a reader slot. A slot must be used by one thread
+ * at a time.
+ * @param map a snapshot hash map.
+ * @return the reader slot, NULL if all SNAPSHOT_HASH_MAP_MAX_READERS slots
+ * are taken.
+ */
+SnapshotReader *SnapshotHashMapRegisterReader(SnapshotHashMap *map);
+
+/**
+ * Gives a reader slot back.
+ * @param map the map the slot belongs to.
+ * @param p_reader pointer to the slot, set to NULL.
+ */
+void SnapshotHashMapUnregisterReader(SnapshotHashMap *map,
+                                     SnapshotReader **p_reader);
+
+/**
+ * Starts reading: returns the current version, which stays valid (and
+ * unchanged) until SnapshotHashMapReadEnd. Only lookup functions (HashMapAt,
+ * HashMapContainsKey, HashMapContainsValue, HashMapAtBatch) may be called
+ * on it. Never blocks.
+ * @param map a snapshot hash map.
+ * @param reader the reader slot of the calling thread.
+ * @return the current version.
+ */
+HashMap *SnapshotHashMapReadBegin(SnapshotHashMap *map,
+                                  SnapshotReader *reader);
+
+/**
+ * Ends reading the version returned by SnapshotHashMapReadBegin.
+ * @param reader the reader slot of the calling thread.
+ */
+void SnapshotHashMapReadEnd(SnapshotReader *reader);
+
+/**
+ * Looks a key up in the current version and, if it is there, calls visit
+ * with its value (valid only during the call). Never blocks.
+ * @param map a snapshot hash map.
+ * @param reader the reader slot of the calling thread.
+ * @param key the key to be checked.
+ * @param visit called with the value and arg if the key is found, may be
+ * NULL.
+ * @param arg passed to visit.
+ * @return 1 if the key is in the map, 0 otherwise.
+ */
+int SnapshotHashMapAt(SnapshotHashMap *map, SnapshotReader *reader, KeyT key,
+                      HashMapValueVisitor visit, void *arg);
+
+/**
+ * The function checks if the given key exists in the current version.
+ * Never blocks.
+ * @param map a snapshot hash map.
+ * @param reader the reader slot of the calling thread.
+ * @param key the key to be checked.
+ * @return 1 if the key is in the map, 0 otherwise.
+ */
+int SnapshotHashMapContainsKey(SnapshotHashMap *map, SnapshotReader *reader,
+                               KeyT key);
+
+/**
+ * Returns the number of pairs in the current version. Never blocks.
+ * @param map a snapshot hash map.
+ * @param reader the reader slot of the calling thread.
+ * @return the number of pairs.
+ */
+size_t SnapshotHashMapGetSize(SnapshotHashMap *map, SnapshotReader *reader);
+
+/**
+ * Publishes a new version made by a copy of the current one and update.
+ * @param map a snapshot hash map.
+ * @param update changes the copy.
+ * @param arg passed to update.
+ * @return 1 if a new version was published, 0 otherwise (the map is not
+ * changed).
+ */
+int SnapshotHashMapUpdate(SnapshotHashMap *map, SnapshotUpdateFunc update,
+                          void *arg);
+
+/**
+ * Publishes a new version with a copy of the pair inserted (HashMapInsert).
+ * @param map a snapshot hash map.
+ * @param pair a pair the map would contain.
+ * @return returns 1 for successful insertion, 0 otherwise.
+ */
+int SnapshotHashMapInsert(SnapshotHashMap *map, Pair *pair);
+
+/**
+ * Publishes a new version without the pair of the given key (HashMapErase).
+ * @param map a snapshot hash map.
+ * @param key the key of the pair to be erased.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+int SnapshotHashMapErase(SnapshotHashMap *map, KeyT key);
+
+#endif //SNAPSHOTHASHMAP_H_
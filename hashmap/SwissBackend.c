@@ -0,0 +1,422 @@
+/**
+ * @file SwissBackend.c
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief the HASH_MAP_SWISS storage engine of HashMap.h - open addressing
+ * with a control byte per slot, probed a group of GROUP_WIDTH slots at once.
+ *
+ * The backend runs the hash it gets through HashMix64 once (the default
+ * hashes of HashMap.h keep the key's bits as they are, so small integer
+ * keys would all start in group 0 and differ only in their low bits) and
+ * keeps the mixed hash in the slot. A full slot's control byte holds the
+ * low 7 bits of the mixed hash (the fingerprint), the remaining bits pick
+ * the first group to probe. A lookup compares the fingerprint against a whole group of control
+ * bytes in one SSE2 instruction, and only calls key_cmp on slots whose
+ * fingerprint and full hash match. A group with an empty slot ends the
+ * probe, so a miss usually costs one group compare and no key_cmp at all.
+ *
+ * @section LICENSE
+ * This program is private and was made for the 2020 67315 course
+ */
+
+// ------------------------------ includes ------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "HashMapBackend.h"
+#include "Hash.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// -------------------------- const definitions -------------------------
+/**
+ * @def GROUP_WIDTH
+ * @brief number of slots probed together (the width of an SSE2 register),
+ * also the minimal capacity of the table
+ */
+#define GROUP_WIDTH 16UL
+
+/**
+ * @def CTRL_EMPTY
+ * @brief control byte of a slot that never held a pair since the last rehash
+ */
+#define CTRL_EMPTY 0x80
+
+/**
+ * @def CTRL_DELETED
+ * @brief control byte of a slot whose pair was erased (a tombstone)
+ */
+#define CTRL_DELETED 0xFE
+
+/**
+ * @def FINGERPRINT
+ * @brief the 7 bits of the (mixed) hash kept in the control byte of a full
+ * slot
+ */
+#define FINGERPRINT(hash) ((unsigned char) ((hash) & 0x7F))
+
+/**
+ * @def FIRST_GROUP
+ * @brief the bits of the (mixed) hash not used by the fingerprint pick the
+ * first group
+ */
+#define FIRST_GROUP(hash, num_groups) (((hash) >> 7) & ((num_groups) - 1))
+
+/**
+ * @def IS_FULL
+ * @brief checks if a control byte belongs to a full slot
+ */
+#define IS_FULL(ctrl_byte) (((ctrl_byte) & 0x80) == 0)
+
+/**
+ * @def MAX_USED
+ * @brief pairs + tombstones may fill up to 7/8 of the table before it is
+ * rehashed in place
+ */
+#define MAX_USED(capacity) ((capacity) - (capacity) / 8)
+
+/**
+ * @struct SwissState
+ * The storage of a HASH_MAP_SWISS map (its backend_state).
+ * @param slots the table, capacity slots.
+ * @param ctrl the control byte of every slot.
+ * @param tombstones number of erased slots not reused yet.
+ */
+typedef struct SwissState {
+  HashMapSlot *slots;
+  unsigned char *ctrl;
+  size_t tombstones;
+} SwissState;
+
+/**
+ * @def STATE
+ * @brief the storage of the map (see SwissState)
+ */
+#define STATE(hash_map) ((SwissState *) (hash_map)->backend_state)
+
+// ------------------------------ functions -----------------------------
+
+/**
+ * builds a bit mask of the slots in the group whose control byte equals byte
+ * @param group the first control byte of the group
+ * @param byte the control byte to look for
+ * @return bit i is on if group[i] == byte
+ */
+static unsigned MatchByte(const unsigned char *group, unsigned char byte);
+
+/**
+ * builds a bit mask of the empty or deleted slots in the group
+ * @param group the first control byte of the group
+ * @return bit i is on if group[i] is not full
+ */
+static unsigned MatchFree(const unsigned char *group);
+
+/**
+ * returns the index of the lowest bit that is on in the mask (mask != 0)
+ */
+static unsigned LowestBit(unsigned mask);
+
+/**
+ * finds the index of the slot holding the given key
+ * @param hash_map HashMap struct object
+ * @param key the key to look for
+ * @param hash the mixed hash of key
+ * @param p_index output - the index of the slot
+ * @return 1 if found, 0 otherwise
+ */
+static int FindIndex(HashMap *hash_map, KeyT key, size_t hash,
+    size_t *p_index);
+
+/**
+ * finds the first free (empty or deleted) slot on the probe sequence of hash
+ * @param ctrl control bytes of the table
+ * @param capacity capacity of the table
+ * @param hash the mixed hash to probe for
+ * @return the index of the slot
+ */
+static size_t FindFree(const unsigned char *ctrl, size_t capacity,
+    size_t hash);
+
+/**
+ * allocates empty control and slot arrays
+ * @param capacity capacity of the new table
+ * @param p_ctrl output - the control bytes
+ * @param p_slots output - the slots
+ * @return 1 upon success, 0 otherwise
+ */
+static int TableAlloc(size_t capacity, unsigned char **p_ctrl,
+    HashMapSlot **p_slots);
+
+/**
+ * counts the groups a lookup probes until it reaches the given group
+ * @param hash the mixed hash looked up
+ * @param group the group its slot is in
+ * @param num_groups the number of groups of the table
+ * @return the number of groups probed (1 for the first group of hash)
+ */
+static size_t GroupsProbed(size_t hash, size_t group, size_t num_groups);
+
+static int SwissInit(HashMap *hash_map, size_t capacity);
+static void SwissDestroy(HashMap *hash_map);
+static Pair **SwissFind(HashMap *hash_map, KeyT key, size_t hash);
+static int SwissInsert(HashMap *hash_map, Pair *pair, size_t hash);
+static int SwissErase(HashMap *hash_map, KeyT key, size_t hash);
+static int SwissResize(HashMap *hash_map, size_t new_capacity);
+static Pair *SwissNext(HashMap *hash_map, size_t *bucket, size_t *pos);
+static void SwissPrefetch(const HashMap *hash_map, size_t hash);
+static void SwissClear(HashMap *hash_map);
+static void SwissStats(const HashMap *hash_map, HashMapStats *stats);
+
+const HashMapBackendOps SwissBackendOps = {
+    SwissInit, SwissDestroy, SwissFind, SwissInsert, SwissErase, SwissResize,
+    SwissNext, SwissPrefetch, SwissClear, SwissStats
+};
+
+#ifdef __SSE2__
+static unsigned MatchByte(const unsigned char *group, unsigned char byte) {
+  __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+  return (unsigned) _mm_movemask_epi8(
+      _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) byte)));
+}
+
+static unsigned MatchFree(const unsigned char *group) {
+  //empty and deleted are the only control bytes with the high bit on
+  return (unsigned) _mm_movemask_epi8(
+      _mm_loadu_si128((const __m128i *) group));
+}
+#else
+static unsigned MatchByte(const unsigned char *group, unsigned char byte) {
+  unsigned mask = 0;
+  for (unsigned i = 0; i < GROUP_WIDTH; i++) {
+    mask |= (unsigned) (group[i] == byte) << i;
+  }
+  return mask;
+}
+
+static unsigned MatchFree(const unsigned char *group) {
+  unsigned mask = 0;
+  for (unsigned i = 0; i < GROUP_WIDTH; i++) {
+    mask |= (unsigned) !IS_FULL(group[i]) << i;
+  }
+  return mask;
+}
+#endif
+
+static unsigned LowestBit(unsigned mask) {
+#ifdef __GNUC__
+  return (unsigned) __builtin_ctz(mask);
+#else
+  unsigned bit = 0;
+  while (!(mask & 1U)) {
+    mask >>= 1;
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+static int FindIndex(HashMap *hash_map, KeyT key, size_t hash,
+    size_t *p_index) {
+  SwissState *state = STATE(hash_map);
+  size_t num_groups = hash_map->capacity / GROUP_WIDTH;
+  size_t group = FIRST_GROUP(hash, num_groups);
+  unsigned char fingerprint = FINGERPRINT(hash);
+  //triangular probing visits every group once when num_groups is a power of 2
+  for (size_t step = 1; step <= num_groups; step++) {
+    const unsigned char *ctrl = state->ctrl + group * GROUP_WIDTH;
+    unsigned candidates = MatchByte(ctrl, fingerprint);
+    while (candidates) {
+      size_t index = group * GROUP_WIDTH + LowestBit(candidates);
+      HashMapSlot *slot = &state->slots[index];
+      if (slot->hash == hash && ENTRY_HAS_KEY(hash_map, slot->pair, key)) {
+        *p_index = index;
+        return SUCCESS;
+      }
+      candidates &= candidates - 1;
+    }
+    if (MatchByte(ctrl, CTRL_EMPTY)) {
+      return FAIL;
+    }
+    group = (group + step) & (num_groups - 1);
+  }
+  return FAIL;
+}
+
+static size_t FindFree(const unsigned char *ctrl, size_t capacity,
+    size_t hash) {
+  size_t num_groups = capacity / GROUP_WIDTH;
+  size_t group = FIRST_GROUP(hash, num_groups);
+  for (size_t step = 1;; step++) {
+    unsigned free_slots = MatchFree(ctrl + group * GROUP_WIDTH);
+    if (free_slots) {
+      return group * GROUP_WIDTH + LowestBit(free_slots);
+    }
+    group = (group + step) & (num_groups - 1);
+  }
+}
+
+static size_t GroupsProbed(size_t hash, size_t group, size_t num_groups) {
+  size_t cur = FIRST_GROUP(hash, num_groups);
+  size_t step = 1;
+  for (; cur != group && step < num_groups; step++) {
+    cur = (cur + step) & (num_groups - 1);
+  }
+  return step;
+}
+
+static int TableAlloc(size_t capacity, unsigned char **p_ctrl,
+    HashMapSlot **p_slots) {
+  *p_ctrl = malloc(capacity);
+  CHECK_ERROR(*p_ctrl, FAIL)
+  *p_slots = malloc(capacity * sizeof(HashMapSlot));
+  if (!(*p_slots)) {
+    free(*p_ctrl);
+    *p_ctrl = NULL;
+    return FAIL;
+  }
+  memset(*p_ctrl, CTRL_EMPTY, capacity);
+  return SUCCESS;
+}
+
+static int SwissInit(HashMap *hash_map, size_t capacity) {
+  if (capacity < GROUP_WIDTH) {
+    capacity = GROUP_WIDTH;
+  }
+  SwissState *state = malloc(sizeof(SwissState));
+  CHECK_ERROR(state, FAIL)
+  if (!TableAlloc(capacity, &state->ctrl, &state->slots)) {
+    free(state);
+    return FAIL;
+  }
+  state->tombstones = 0;
+  hash_map->backend_state = state;
+  hash_map->capacity = capacity;
+  return SUCCESS;
+}
+
+static void SwissDestroy(HashMap *hash_map) {
+  SwissState *state = STATE(hash_map);
+  CHECK_ERROR(state, NO_RETURN_VALUE)
+  SwissClear(hash_map);
+  free(state->ctrl);
+  free(state->slots);
+  free(state);
+  hash_map->backend_state = NULL;
+}
+
+static Pair **SwissFind(HashMap *hash_map, KeyT key, size_t hash) {
+  hash = HashMix64(hash);
+  size_t index = 0;
+  CHECK_ERROR(FindIndex(hash_map, key, hash, &index), NULL)
+  return &STATE(hash_map)->slots[index].pair;
+}
+
+static int SwissInsert(HashMap *hash_map, Pair *pair, size_t hash) {
+  SwissState *state = STATE(hash_map);
+  hash = HashMix64(hash);
+  size_t index = FindFree(state->ctrl, hash_map->capacity, hash);
+  if (state->ctrl[index] == CTRL_EMPTY && hash_map->size +
+      state->tombstones + 1 > MAX_USED(hash_map->capacity)) {
+    //too many tombstones- rehash in place to get rid of them
+    CHECK_ERROR(SwissResize(hash_map, hash_map->capacity), FAIL)
+    HASH_MAP_COUNT(hash_map, rehashed_pairs, hash_map->size);
+    index = FindFree(state->ctrl, hash_map->capacity, hash);
+  }
+  Pair *pair_copy = HashMapEntryCopy(hash_map, pair);
+  CHECK_ERROR(pair_copy, FAIL)
+  if (state->ctrl[index] == CTRL_DELETED) {
+    state->tombstones--;
+  }
+  state->ctrl[index] = FINGERPRINT(hash);
+  state->slots[index].hash = hash;
+  state->slots[index].pair = pair_copy;
+  return SUCCESS;
+}
+
+static int SwissErase(HashMap *hash_map, KeyT key, size_t hash) {
+  SwissState *state = STATE(hash_map);
+  hash = HashMix64(hash);
+  size_t index = 0;
+  CHECK_ERROR(FindIndex(hash_map, key, hash, &index), FAIL)
+  HashMapEntryFree(hash_map, &state->slots[index].pair);
+  //a group that has an empty slot was never full, so no probe went past it
+  // and the slot can become empty again
+  const unsigned char *group = state->ctrl + index / GROUP_WIDTH *
+      GROUP_WIDTH;
+  if (MatchByte(group, CTRL_EMPTY)) {
+    state->ctrl[index] = CTRL_EMPTY;
+  } else {
+    state->ctrl[index] = CTRL_DELETED;
+    state->tombstones++;
+  }
+  return SUCCESS;
+}
+
+static int SwissResize(HashMap *hash_map, size_t new_capacity) {
+  SwissState *state = STATE(hash_map);
+  if (new_capacity < GROUP_WIDTH) {
+    new_capacity = GROUP_WIDTH;
+  }
+  if (new_capacity == hash_map->capacity && state->tombstones == 0) {
+    return SUCCESS;
+  }
+  unsigned char *new_ctrl = NULL;
+  HashMapSlot *new_slots = NULL;
+  CHECK_ERROR(TableAlloc(new_capacity, &new_ctrl, &new_slots), FAIL)
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    if (IS_FULL(state->ctrl[i])) {
+      size_t hash = state->slots[i].hash;
+      size_t index = FindFree(new_ctrl, new_capacity, hash);
+      new_ctrl[index] = FINGERPRINT(hash);
+      new_slots[index] = state->slots[i];
+    }
+  }
+  free(state->ctrl);
+  free(state->slots);
+  state->ctrl = new_ctrl;
+  state->slots = new_slots;
+  hash_map->capacity = new_capacity;
+  state->tombstones = 0;
+  return SUCCESS;
+}
+
+static Pair *SwissNext(HashMap *hash_map, size_t *bucket, size_t *pos) {
+  SwissState *state = STATE(hash_map);
+  (void) pos;
+  for (; *bucket < hash_map->capacity; (*bucket)++) {
+    if (IS_FULL(state->ctrl[*bucket])) {
+      return state->slots[(*bucket)++].pair;
+    }
+  }
+  return NULL;
+}
+
+static void SwissClear(HashMap *hash_map) {
+  SwissState *state = STATE(hash_map);
+  for (size_t i = 0; i < hash_map->capacity && !ENTRIES_IN_ARENA(hash_map);
+       i++) {
+    if (IS_FULL(state->ctrl[i])) {
+      HashMapEntryFree(hash_map, &state->slots[i].pair);
+    }
+  }
+  memset(state->ctrl, CTRL_EMPTY, hash_map->capacity);
+  state->tombstones = 0;
+}
+
+static void SwissStats(const HashMap *hash_map, HashMapStats *stats) {
+  const SwissState *state = STATE(hash_map);
+  size_t num_groups = hash_map->capacity / GROUP_WIDTH;
+  for (size_t i = 0; i < hash_map->capacity; i++) {
+    HashMapStatsAddChain(stats, !IS_FULL(state->ctrl[i]) ? 0 :
+        GroupsProbed(state->slots[i].hash, i / GROUP_WIDTH, num_groups));
+  }
+}
+
+static void SwissPrefetch(const HashMap *hash_map, size_t hash) {
+  const SwissState *state = STATE(hash_map);
+  hash = HashMix64(hash);
+  size_t first = FIRST_GROUP(hash, hash_map->capacity / GROUP_WIDTH) *
+      GROUP_WIDTH;
+  HASH_MAP_PREFETCH(&state->ctrl[first]);
+  HASH_MAP_PREFETCH(&state->slots[first]);
+}
@@ -0,0 +1,252 @@
+/**
+ * @file TypedHashMap.h
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief a generator of type specialized hash maps.
+ *
+ * DEFINE_HASHMAP(Name, KeyType, ValueType, hash_func, eq) defines a hash map
+ * type called Name whose keys and values are stored by value inside the slot
+ * array, so inserting never allocates a key or a value and the hash and
+ * equality functions can be inlined by the compiler (no void *, no function
+ * pointers). The map is a Robin Hood open addressing table (like
+ * HASH_MAP_ROBIN_HOOD) that grows and shrinks with the load factors of
+ * HashMap.h.
+ *
+ * hash_func is a function or a macro size_t hash_func(KeyType), eq is a
+ * function or a macro int eq(KeyType, KeyType) returning 1 for equal keys.
+ * Like HASH_MAP_SWISS, the map runs every hash through HashMix64 once and
+ * keeps the mixed hash in the slot, so a hash that keeps the key's bits as
+ * they are (TypedHashInt, TypedHashChar) still spreads keys that differ only
+ * in their high bits over the whole table instead of one long probe run.
+ *
+ * Example:
+ *   DEFINE_HASHMAP(IntIntMap, int, int, TypedHashInt, TypedEqualsInt)
+ *   IntIntMap *map = IntIntMapAlloc();
+ *   IntIntMapInsert(map, 4, 16);
+ *   int *value = IntIntMapAt(map, 4);
+ *   IntIntMapFree(&map);
+ *
+ * Generated functions (all static inline):
+ *   Name *NameAlloc(void);
+ *   void NameFree(Name **p_map);
+ *   int NameInsert(Name *map, KeyType key, ValueType value);
+ *   ValueType *NameAt(Name *map, KeyType key);
+ *   int NameContainsKey(Name *map, KeyType key);
+ *   int NameErase(Name *map, KeyType key);
+ *   void NameClear(Name *map);
+ *   double NameGetLoadFactor(Name *map);
+ * Insert and Erase return 1 upon success, 0 otherwise, At returns a pointer
+ * to the value inside the map (valid until the next Insert or Erase), NULL
+ * if the key is not in the map.
+ */
+
+#ifndef TYPEDHASHMAP_H_
+#define TYPEDHASHMAP_H_
+
+#include <stdlib.h>
+#include "HashMap.h"
+#include "Hash.h"
+
+/**
+ * Integers hash func for typed maps (the map mixes it).
+ */
+static inline size_t TypedHashInt(int key) {
+  return (size_t) key;
+}
+
+/**
+ * Chars hash func for typed maps (the map mixes it).
+ */
+static inline size_t TypedHashChar(char key) {
+  return (size_t) key;
+}
+
+/**
+ * Integers compare func for typed maps.
+ */
+static inline int TypedEqualsInt(int key_1, int key_2) {
+  return key_1 == key_2;
+}
+
+/**
+ * Chars compare func for typed maps.
+ */
+static inline int TypedEqualsChar(char key_1, char key_2) {
+  return key_1 == key_2;
+}
+
+/**
+ * @def DEFINE_HASHMAP
+ * Defines the slot type Name##Slot, the map type Name and its functions.
+ */
+#define DEFINE_HASHMAP(Name, KeyType, ValueType, hash_func, eq) \
+\
+typedef struct Name##Slot { \
+  size_t hash; \
+  int full; \
+  KeyType key; \
+  ValueType value; \
+} Name##Slot; \
+\
+typedef struct Name { \
+  Name##Slot *slots; \
+  size_t size; \
+  size_t capacity; \
+} Name; \
+\
+static inline Name *Name##Alloc(void) { \
+  Name *map = malloc(sizeof(Name)); \
+  if (!map) { \
+    return NULL; \
+  } \
+  map->slots = calloc(HASH_MAP_INITIAL_CAP, sizeof(Name##Slot)); \
+  if (!map->slots) { \
+    free(map); \
+    return NULL; \
+  } \
+  map->size = 0; \
+  map->capacity = HASH_MAP_INITIAL_CAP; \
+  return map; \
+} \
+\
+static inline size_t Name##Hash(KeyType key) { \
+  return (size_t) HashMix64((uint64_t) hash_func(key)); \
+} \
+\
+static inline void Name##Free(Name **p_map) { \
+  if (!p_map || !(*p_map)) { \
+    return; \
+  } \
+  free((*p_map)->slots); \
+  free(*p_map); \
+  *p_map = NULL; \
+} \
+\
+static inline void Name##Place(Name##Slot *slots, size_t mask, \
+                               Name##Slot to_place) { \
+  size_t index = to_place.hash & mask; \
+  size_t dist = 0; \
+  while (slots[index].full) { \
+    size_t cur_dist = (index - (slots[index].hash & mask)) & mask; \
+    if (cur_dist < dist) { \
+      Name##Slot tmp = slots[index]; \
+      slots[index] = to_place; \
+      to_place = tmp; \
+      dist = cur_dist; \
+    } \
+    index = (index + 1) & mask; \
+    dist++; \
+  } \
+  slots[index] = to_place; \
+} \
+\
+static inline int Name##Resize(Name *map, size_t new_capacity) { \
+  Name##Slot *new_slots = calloc(new_capacity, sizeof(Name##Slot)); \
+  if (!new_slots) { \
+    return 0; \
+  } \
+  for (size_t i = 0; i < map->capacity; i++) { \
+    if (map->slots[i].full) { \
+      Name##Place(new_slots, new_capacity - 1, map->slots[i]); \
+    } \
+  } \
+  free(map->slots); \
+  map->slots = new_slots; \
+  map->capacity = new_capacity; \
+  return 1; \
+} \
+\
+static inline Name##Slot *Name##FindSlot(Name *map, KeyType key, \
+                                         size_t key_hash) { \
+  size_t mask = map->capacity - 1; \
+  size_t index = key_hash & mask; \
+  for (size_t dist = 0; dist < map->capacity; dist++) { \
+    Name##Slot *slot = &map->slots[index]; \
+    if (!slot->full || ((index - (slot->hash & mask)) & mask) < dist) { \
+      return NULL; \
+    } \
+    if (slot->hash == key_hash && eq(slot->key, key)) { \
+      return slot; \
+    } \
+    index = (index + 1) & mask; \
+  } \
+  return NULL; \
+} \
+\
+static inline int Name##Insert(Name *map, KeyType key, ValueType value) { \
+  if (!map) { \
+    return 0; \
+  } \
+  size_t key_hash = Name##Hash(key); \
+  Name##Slot *existing = Name##FindSlot(map, key, key_hash); \
+  if (existing) { \
+    existing->value = value; \
+    return 1; \
+  } \
+  if ((double) (map->size + 1) / map->capacity > HASH_MAP_MAX_LOAD_FACTOR && \
+      !Name##Resize(map, map->capacity * HASH_MAP_GROWTH_FACTOR)) { \
+    return 0; \
+  } \
+  Name##Slot to_place = {key_hash, 1, key, value}; \
+  Name##Place(map->slots, map->capacity - 1, to_place); \
+  map->size++; \
+  return 1; \
+} \
+\
+static inline ValueType *Name##At(Name *map, KeyType key) { \
+  if (!map) { \
+    return NULL; \
+  } \
+  Name##Slot *slot = Name##FindSlot(map, key, Name##Hash(key)); \
+  return slot ? &slot->value : NULL; \
+} \
+\
+static inline int Name##ContainsKey(Name *map, KeyType key) { \
+  return Name##At(map, key) != NULL; \
+} \
+\
+static inline int Name##Erase(Name *map, KeyType key) { \
+  if (!map) { \
+    return 0; \
+  } \
+  size_t key_hash = Name##Hash(key); \
+  if (!Name##FindSlot(map, key, key_hash)) { \
+    return 0; \
+  } \
+  size_t new_capacity = map->capacity / HASH_MAP_GROWTH_FACTOR; \
+  if ((double) (map->size - 1) / map->capacity < HASH_MAP_MIN_LOAD_FACTOR && \
+      new_capacity > 0 && !Name##Resize(map, new_capacity)) { \
+    return 0; \
+  } \
+  size_t mask = map->capacity - 1; \
+  size_t index = Name##FindSlot(map, key, key_hash) - map->slots; \
+  size_t next = (index + 1) & mask; \
+  while (map->slots[next].full && \
+         ((next - (map->slots[next].hash & mask)) & mask) != 0) { \
+    map->slots[index] = map->slots[next]; \
+    index = next; \
+    next = (next + 1) & mask; \
+  } \
+  map->slots[index].full = 0; \
+  map->size--; \
+  return 1; \
+} \
+\
+static inline void Name##Clear(Name *map) { \
+  if (!map) { \
+    return; \
+  } \
+  for (size_t i = 0; i < map->capacity; i++) { \
+    map->slots[i].full = 0; \
+  } \
+  map->size = 0; \
+} \
+\
+static inline double Name##GetLoadFactor(Name *map) { \
+  if (!map || map->capacity == 0) { \
+    return -1; \
+  } \
+  return (double) map->size / map->capacity; \
+}
+
+#endif //TYPEDHASHMAP_H_
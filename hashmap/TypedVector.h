@@ -0,0 +1,353 @@
+/**
+ * @file TypedVector.h
+ * @author  Eran Turgeman <eran.turgeman@mail.huji.ac.il>
+ *
+ * @brief a generator of type specialized vectors.
+ *
+ * DEFINE_VECTOR(Name, ElemType) defines a vector type called Name whose
+ * elements are stored by value, one after the other, in its data array: a
+ * push copies the element into the array (no malloc per element, no copy
+ * function), and NameAt returns a pointer into the array (no pointer to
+ * follow). Unlike Vector.h the vector grows only when it is full and never
+ * shrinks by itself (like VECTOR_SHRINK_MANUAL), so big numeric arrays cost
+ * their elements and little more.
+ *
+ * Example:
+ *   DEFINE_VECTOR(IntVector, int)
+ *   IntVector *vec = IntVectorAlloc();
+ *   IntVectorPushBack(vec, 4);
+ *   *IntVectorEmplaceBack(vec) = 16;
+ *   int *first = IntVectorAt(vec, 0);
+ *   IntVectorFree(&vec);
+ *
+ * Generated functions (all static inline):
+ *   Name *NameAlloc(void);
+ *   void NameFree(Name **p_vector);
+ *   ElemType *NameAt(Name *vector, size_t ind);
+ *   int NameReserve(Name *vector, size_t num_elems);
+ *   ElemType *NameEmplaceBack(Name *vector);
+ *   int NamePushBack(Name *vector, ElemType value);
+ *   int NameErase(Name *vector, size_t ind);
+ *   int NameEraseUnordered(Name *vector, size_t ind);
+ *   void NameClear(Name *vector);
+ *   int NameShrinkToFit(Name *vector);
+ *   double NameGetLoadFactor(Name *vector);
+ * At returns a pointer to the element inside the vector, NULL if ind is out
+ * of range. EmplaceBack adds an uninitialized element and returns a pointer
+ * to it, NULL if failed. Both pointers are valid until the vector grows or
+ * shrinks. The int functions return 1 upon success, 0 otherwise.
+ *
+ * DEFINE_VECTOR_FIND(Name, ElemType, find, count) adds a linear search to a
+ * vector defined by DEFINE_VECTOR. find is a function
+ * size_t find(const ElemType *data, size_t size, ElemType value,
+ * size_t start) returning the index of the first element equal to value at
+ * or after start (size if there is none), count is a function
+ * size_t count(const ElemType *data, size_t size, ElemType value). The
+ * TypedVectorFind and TypedVectorCount functions below compare 8 to 32 ints,
+ * doubles or chars per instruction with AVX2 (4 to 16 with SSE2, one at a
+ * time without either); compile with -mavx2 to get the wider ones.
+ *
+ * Example:
+ *   DEFINE_VECTOR_FIND(IntVector, int, TypedVectorFindInt,
+ *                      TypedVectorCountInt)
+ *   for (size_t i = IntVectorFind(vec, 4, 0); i < vec->size;
+ *        i = IntVectorFind(vec, 4, i + 1)) {
+ *     ...every index of a 4...
+ *   }
+ *
+ * Generated functions (all static inline):
+ *   size_t NameFind(Name *vector, ElemType value, size_t start);
+ *   size_t NameCount(Name *vector, ElemType value);
+ * Find returns vector->size (0 for NULL) if no element at or after start
+ * equals value.
+ */
+
+#ifndef TYPEDVECTOR_H_
+#define TYPEDVECTOR_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "Vector.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Returns the index of the lowest set bit of a non zero mask.
+ */
+static inline unsigned TypedVectorLowestBit(unsigned mask) {
+#ifdef __GNUC__
+  return (unsigned) __builtin_ctz(mask);
+#else
+  unsigned bit = 0;
+  while (!(mask & 1U)) {
+    mask >>= 1;
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+/**
+ * Returns the number of set bits of a mask.
+ */
+static inline size_t TypedVectorBitCount(unsigned mask) {
+#ifdef __GNUC__
+  return (size_t) __builtin_popcount(mask);
+#else
+  size_t count = 0;
+  for (; mask; mask &= mask - 1) {
+    count++;
+  }
+  return count;
+#endif
+}
+
+/**
+ * @def TYPED_VECTOR_WIDTH_INT, TYPED_VECTOR_WIDTH_DOUBLE,
+ * TYPED_VECTOR_WIDTH_CHAR
+ * The number of elements compared by one instruction (1 without SIMD).
+ * @def TYPED_VECTOR_MATCH_INT, TYPED_VECTOR_MATCH_DOUBLE,
+ * TYPED_VECTOR_MATCH_CHAR
+ * A mask with bit i set if p[i] equals the broadcast needle, for i in
+ * [0, width).
+ */
+#if defined(__AVX2__)
+#define TYPED_VECTOR_WIDTH_INT 8
+#define TYPED_VECTOR_WIDTH_DOUBLE 4
+#define TYPED_VECTOR_WIDTH_CHAR 32
+#define TYPED_VECTOR_NEEDLE_INT(value) _mm256_set1_epi32(value)
+#define TYPED_VECTOR_NEEDLE_DOUBLE(value) _mm256_set1_pd(value)
+#define TYPED_VECTOR_NEEDLE_CHAR(value) _mm256_set1_epi8(value)
+#define TYPED_VECTOR_MATCH_INT(p, needle) ((unsigned) _mm256_movemask_ps( \
+    _mm256_castsi256_ps(_mm256_cmpeq_epi32( \
+        _mm256_loadu_si256((const __m256i *) (p)), (needle)))))
+#define TYPED_VECTOR_MATCH_DOUBLE(p, needle) ((unsigned) _mm256_movemask_pd( \
+    _mm256_cmp_pd(_mm256_loadu_pd(p), (needle), _CMP_EQ_OQ)))
+#define TYPED_VECTOR_MATCH_CHAR(p, needle) ((unsigned) _mm256_movemask_epi8( \
+    _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p)), (needle))))
+#elif defined(__SSE2__)
+#define TYPED_VECTOR_WIDTH_INT 4
+#define TYPED_VECTOR_WIDTH_DOUBLE 2
+#define TYPED_VECTOR_WIDTH_CHAR 16
+#define TYPED_VECTOR_NEEDLE_INT(value) _mm_set1_epi32(value)
+#define TYPED_VECTOR_NEEDLE_DOUBLE(value) _mm_set1_pd(value)
+#define TYPED_VECTOR_NEEDLE_CHAR(value) _mm_set1_epi8(value)
+#define TYPED_VECTOR_MATCH_INT(p, needle) ((unsigned) _mm_movemask_ps( \
+    _mm_castsi128_ps(_mm_cmpeq_epi32( \
+        _mm_loadu_si128((const __m128i *) (p)), (needle)))))
+#define TYPED_VECTOR_MATCH_DOUBLE(p, needle) ((unsigned) _mm_movemask_pd( \
+    _mm_cmpeq_pd(_mm_loadu_pd(p), (needle))))
+#define TYPED_VECTOR_MATCH_CHAR(p, needle) ((unsigned) _mm_movemask_epi8( \
+    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p)), (needle))))
+#else
+#define TYPED_VECTOR_WIDTH_INT 1
+#define TYPED_VECTOR_WIDTH_DOUBLE 1
+#define TYPED_VECTOR_WIDTH_CHAR 1
+#define TYPED_VECTOR_NEEDLE_INT(value) (value)
+#define TYPED_VECTOR_NEEDLE_DOUBLE(value) (value)
+#define TYPED_VECTOR_NEEDLE_CHAR(value) (value)
+#define TYPED_VECTOR_MATCH_INT(p, needle) ((unsigned) (*(p) == (needle)))
+#define TYPED_VECTOR_MATCH_DOUBLE(p, needle) ((unsigned) (*(p) == (needle)))
+#define TYPED_VECTOR_MATCH_CHAR(p, needle) ((unsigned) (*(p) == (needle)))
+#endif
+
+/**
+ * @def DEFINE_TYPED_VECTOR_SEARCH
+ * Defines TypedVectorFind##Suffix and TypedVectorCount##Suffix for ElemType:
+ * whole groups of WIDTH elements are compared at once, the tail one by one.
+ */
+#define DEFINE_TYPED_VECTOR_SEARCH(Suffix, ElemType, WIDTH, NEEDLE, MATCH) \
+\
+static inline size_t TypedVectorFind##Suffix(const ElemType *data, \
+    size_t size, ElemType value, size_t start) { \
+  size_t i = start; \
+  for (; i + (WIDTH) <= size; i += (WIDTH)) { \
+    unsigned mask = MATCH(data + i, NEEDLE(value)); \
+    if (mask) { \
+      return i + TypedVectorLowestBit(mask); \
+    } \
+  } \
+  for (; i < size; i++) { \
+    if (data[i] == value) { \
+      return i; \
+    } \
+  } \
+  return size; \
+} \
+\
+static inline size_t TypedVectorCount##Suffix(const ElemType *data, \
+    size_t size, ElemType value) { \
+  size_t count = 0, i = 0; \
+  for (; i + (WIDTH) <= size; i += (WIDTH)) { \
+    count += TypedVectorBitCount(MATCH(data + i, NEEDLE(value))); \
+  } \
+  for (; i < size; i++) { \
+    count += data[i] == value; \
+  } \
+  return count; \
+}
+
+DEFINE_TYPED_VECTOR_SEARCH(Int, int, TYPED_VECTOR_WIDTH_INT,
+                           TYPED_VECTOR_NEEDLE_INT, TYPED_VECTOR_MATCH_INT)
+DEFINE_TYPED_VECTOR_SEARCH(Double, double, TYPED_VECTOR_WIDTH_DOUBLE,
+                           TYPED_VECTOR_NEEDLE_DOUBLE,
+                           TYPED_VECTOR_MATCH_DOUBLE)
+DEFINE_TYPED_VECTOR_SEARCH(Char, char, TYPED_VECTOR_WIDTH_CHAR,
+                           TYPED_VECTOR_NEEDLE_CHAR, TYPED_VECTOR_MATCH_CHAR)
+
+/**
+ * @def DEFINE_VECTOR
+ * Defines the vector type Name and its functions.
+ */
+#define DEFINE_VECTOR(Name, ElemType) \
+\
+typedef struct Name { \
+  ElemType *data; \
+  size_t size; \
+  size_t capacity; \
+} Name; \
+\
+static inline Name *Name##Alloc(void) { \
+  Name *vector = malloc(sizeof(Name)); \
+  if (!vector) { \
+    return NULL; \
+  } \
+  vector->data = malloc(VECTOR_INITIAL_CAP * sizeof(ElemType)); \
+  if (!vector->data) { \
+    free(vector); \
+    return NULL; \
+  } \
+  vector->size = 0; \
+  vector->capacity = VECTOR_INITIAL_CAP; \
+  return vector; \
+} \
+\
+static inline void Name##Free(Name **p_vector) { \
+  if (!p_vector || !(*p_vector)) { \
+    return; \
+  } \
+  free((*p_vector)->data); \
+  free(*p_vector); \
+  *p_vector = NULL; \
+} \
+\
+static inline ElemType *Name##At(Name *vector, size_t ind) { \
+  if (!vector || ind >= vector->size) { \
+    return NULL; \
+  } \
+  return &vector->data[ind]; \
+} \
+\
+static inline int Name##Resize(Name *vector, size_t new_capacity) { \
+  if (new_capacity > SIZE_MAX / sizeof(ElemType)) { \
+    return 0; \
+  } \
+  ElemType *new_data = realloc(vector->data, \
+                               new_capacity * sizeof(ElemType)); \
+  if (!new_data) { \
+    return 0; \
+  } \
+  vector->data = new_data; \
+  vector->capacity = new_capacity; \
+  return 1; \
+} \
+\
+static inline int Name##Reserve(Name *vector, size_t num_elems) { \
+  if (!vector) { \
+    return 0; \
+  } \
+  size_t new_capacity = vector->capacity; \
+  while (new_capacity < num_elems) { \
+    if (new_capacity > SIZE_MAX / VECTOR_GROWTH_FACTOR) { \
+      return 0; \
+    } \
+    new_capacity *= VECTOR_GROWTH_FACTOR; \
+  } \
+  return new_capacity == vector->capacity || \
+      Name##Resize(vector, new_capacity); \
+} \
+\
+static inline ElemType *Name##EmplaceBack(Name *vector) { \
+  if (!vector || !Name##Reserve(vector, vector->size + 1)) { \
+    return NULL; \
+  } \
+  return &vector->data[vector->size++]; \
+} \
+\
+static inline int Name##PushBack(Name *vector, ElemType value) { \
+  ElemType *slot = Name##EmplaceBack(vector); \
+  if (!slot) { \
+    return 0; \
+  } \
+  *slot = value; \
+  return 1; \
+} \
+\
+static inline int Name##Erase(Name *vector, size_t ind) { \
+  if (!vector || ind >= vector->size) { \
+    return 0; \
+  } \
+  memmove(&vector->data[ind], &vector->data[ind + 1], \
+          (vector->size - ind - 1) * sizeof(ElemType)); \
+  vector->size--; \
+  return 1; \
+} \
+\
+static inline int Name##EraseUnordered(Name *vector, size_t ind) { \
+  if (!vector || ind >= vector->size) { \
+    return 0; \
+  } \
+  vector->data[ind] = vector->data[--vector->size]; \
+  return 1; \
+} \
+\
+static inline void Name##Clear(Name *vector) { \
+  if (!vector) { \
+    return; \
+  } \
+  vector->size = 0; \
+} \
+\
+static inline int Name##ShrinkToFit(Name *vector) { \
+  if (!vector) { \
+    return 0; \
+  } \
+  size_t new_capacity = vector->size > VECTOR_INITIAL_CAP ? \
+      vector->size : VECTOR_INITIAL_CAP; \
+  return new_capacity >= vector->capacity || \
+      Name##Resize(vector, new_capacity); \
+} \
+\
+static inline double Name##GetLoadFactor(Name *vector) { \
+  if (!vector || vector->capacity == 0) { \
+    return -1; \
+  } \
+  return (double) vector->size / vector->capacity; \
+}
+
+/**
+ * @def DEFINE_VECTOR_FIND
+ * Defines the search functions of the vector type Name.
+ */
+#define DEFINE_VECTOR_FIND(Name, ElemType, find, count) \
+\
+static inline size_t Name##Find(Name *vector, ElemType value, \
+                                size_t start) { \
+  if (!vector) { \
+    return 0; \
+  } \
+  if (start >= vector->size) { \
+    return vector->size; \
+  } \
+  return find(vector->data, vector->size, value, start); \
+} \
+\
+static inline size_t Name##Count(Name *vector, ElemType value) { \
+  return vector ? count(vector->data, vector->size, value) : 0; \
+}
+
+#endif //TYPEDVECTOR_H_
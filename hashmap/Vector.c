@@ -13,6 +13,9 @@
 // ------------------------------ includes ------------------------------
 #include <string.h>
 #include "Vector.h"
+#ifdef VECTOR_PARALLEL_SORT
+#include <pthread.h>
+#endif
 
 // -------------------------- const definitions -------------------------
 
@@ -55,6 +58,12 @@ return ret_val;\
  */
 #define LOAD_FACTOR_FAIL -1
 
+/**
+ * @def INSERTION_SORT_MAX
+ * @brief runs of at most this many elements are insertion sorted
+ */
+#define INSERTION_SORT_MAX 16
+
 // ------------------------------ functions -----------------------------
 
 typedef void* vectorElemT;
@@ -81,6 +90,88 @@ static void VectorCloseHole(Vector *vector, size_t ind);
  */
 static void VectorOpenHole(Vector *vector, size_t ind);
 
+/**
+ * halves the capacity of the vector after an erase if its load factor
+ * dropped below VECTOR_MIN_LOAD_FACTOR and its policy shrinks on erase
+ * @param vector Vector struct object
+ * @return 1 upon success (also if no shrinking was needed), 0 otherwise
+ */
+static int ShrinkOnErase(Vector *vector);
+
+/**
+ * calculates the capacity the vector would have after erasing num_erased of
+ * its elements one by one (its capacity if it does not shrink on erase)
+ * @param vector Vector struct object
+ * @param num_erased the number of elements erased
+ * @return the capacity
+ */
+static size_t CapacityAfterErasing(const Vector *vector, size_t num_erased);
+
+/**
+ * copies num_values values into the vector's data array from index ind on
+ * @param vector Vector struct object
+ * @param ind the index of the first copy
+ * @param values the values to be copied
+ * @param num_values the number of values
+ * @return 1 upon success, 0 otherwise (no copy is left in the array)
+ */
+static int CopyValuesTo(Vector *vector, size_t ind, void *const *values,
+                        size_t num_values);
+
+/**
+ * finds the first element in data[0, size) not ordered before value
+ * @param data sorted elements
+ * @param size number of elements
+ * @param value the value to look for
+ * @param order the order of the elements
+ * @param strict 1 to find the first element ordered after value instead
+ * @return its index, size if there is none
+ */
+static size_t BinarySearch(vectorElemT *data, size_t size, const void *value,
+                           VectorElemOrder order, int strict);
+
+/**
+ * sorts data[0, size): quicksort with a median of three pivot, heapsort
+ * once depth_limit partitions did not finish it, insertion sort on short
+ * runs
+ */
+static void IntroSort(vectorElemT *data, size_t size, VectorElemOrder order,
+                      size_t depth_limit);
+
+/**
+ * sorts data[0, size) with heapsort
+ */
+static void HeapSort(vectorElemT *data, size_t size, VectorElemOrder order);
+
+/**
+ * sorts data[0, size) with insertion sort
+ */
+static void InsertionSort(vectorElemT *data, size_t size,
+                          VectorElemOrder order);
+
+/**
+ * sorts data[0, size) with introsort, allowing 2 * log2(size) partition
+ * levels
+ */
+static void SortRun(vectorElemT *data, size_t size, VectorElemOrder order);
+
+/**
+ * merges the sorted runs data[0, mid) and data[mid, size)
+ * @param tmp room for size elements
+ */
+static void MergeRuns(vectorElemT *data, vectorElemT *tmp, size_t mid,
+                      size_t size, VectorElemOrder order);
+
+#ifdef VECTOR_PARALLEL_SORT
+/**
+ * sorts data[0, size) by introsorting VECTOR_SORT_THREADS runs in parallel
+ * and merging them (the merges of a level in parallel as well)
+ * @return 1 upon success, 0 if no memory for the merges
+ */
+static int ParallelSort(vectorElemT *data, size_t size,
+                        VectorElemOrder order);
+#endif
+
 
 Vector *VectorAlloc(VectorElemCpy elem_copy_func, VectorElemCmp
 elem_cmp_func, VectorElemFree elem_free_func){
@@ -95,6 +186,8 @@ elem_cmp_func, VectorElemFree elem_free_func){
   vector->elem_cmp_func = elem_cmp_func;
   vector->elem_copy_func = elem_copy_func;
   vector->elem_free_func = elem_free_func;
+  vector->shrink_policy = VECTOR_SHRINK_ON_ERASE;
+  vector->order = NULL;
   vectorElemT *vec_data = malloc(VECTOR_INITIAL_CAP * sizeof(vectorElemT));
   if(!vec_data)
   {
@@ -131,6 +224,16 @@ int VectorFind(Vector *vector, void *value){
 
   CHECK_ERROR(vector, VAL_NOT_IN_VEC)
   CHECK_ERROR(value, VAL_NOT_IN_VEC)
+  if(vector->order){
+    //equivalent elements are neighbours- check each of them for equality
+    for(size_t i = VectorLowerBound(vector, value); i < vector->size &&
+    vector->order(vector->data[i], value) == 0; i++){
+      if(vector->elem_cmp_func(vector->data[i], value)){
+        return i;
+      }
+    }
+    return VAL_NOT_IN_VEC;
+  }
   if(vector->size != 0){
     for(size_t i = 0; i < vector->size; i++){
       if(vector->elem_cmp_func(vector->data[i], value)){
@@ -156,10 +259,20 @@ int VectorPushBack(Vector *vector, void *value){
   CHECK_ERROR(value, FAIL)
   void *val_copy = vector->elem_copy_func((const void*)value);
   CHECK_ERROR(val_copy, FAIL)
+  if(!VectorPushBackOwned(vector, val_copy)){
+    vector->elem_free_func(&val_copy);
+    return FAIL;
+  }
+  return SUCCESS;
+}
+
+int VectorPushBackOwned(Vector *vector, void *value){
+
+  CHECK_ERROR(vector, FAIL)
+  CHECK_ERROR(value, FAIL)
   vector->size++; //increase to get the load factor "after" insert
   double cur_load_factor = VectorGetLoadFactor(vector);
   if(cur_load_factor == LOAD_FACTOR_FAIL){
-    vector->elem_free_func(val_copy);
     vector->size--;
     return FAIL;
   }
@@ -167,13 +280,19 @@ int VectorPushBack(Vector *vector, void *value){
     int resize_succeeded = ResizeArray(&(vector->data), vector->capacity *
     VECTOR_GROWTH_FACTOR * sizeof(vectorElemT));
     if(!resize_succeeded){
-      vector->elem_free_func(val_copy);
       vector->size--;
       return FAIL;
     }
     vector->capacity = vector->capacity * VECTOR_GROWTH_FACTOR;
   }
-  vector->data[vector->size - 1] = val_copy;
+  size_t ind = vector->size - 1;
+  if(vector->order){
+    ind = BinarySearch(vector->data, vector->size - 1, value, vector->order,
+                       1);
+    memmove(&vector->data[ind + 1], &vector->data[ind],
+            (vector->size - 1 - ind) * sizeof(vectorElemT));
+  }
+  vector->data[ind] = value;
   return SUCCESS;
 }
 static int ResizeArray(void ***p_array_to_resize, const size_t new_size) {
@@ -202,20 +321,73 @@ int VectorErase(Vector *vector, size_t ind){
   vector->data[ind] = NULL;
   VectorCloseHole(vector, ind);
 
-  if(cur_load_factor < VECTOR_MIN_LOAD_FACTOR){
-    int resize_succeeded = ResizeArray(&(vector->data),(vector->capacity /
-    VECTOR_GROWTH_FACTOR) * sizeof(vectorElemT));
-    if(!resize_succeeded){
-      VectorOpenHole(vector, ind);
-      vector->data[ind] = tmp;
-      vector->size++;
-      return FAIL;
-    }
-    vector->capacity = vector->capacity / VECTOR_GROWTH_FACTOR;
+  if(!ShrinkOnErase(vector)){
+    VectorOpenHole(vector, ind);
+    vector->data[ind] = tmp;
+    vector->size++;
+    return FAIL;
+  }
+  vector->elem_free_func(&tmp);
+  return SUCCESS;
+
+}
+
+int VectorEraseUnordered(Vector *vector, size_t ind){
+
+  CHECK_ERROR(vector, FAIL)
+  CHECK_ERROR(ind < vector->size, FAIL)
+  if(vector->order){
+    return VectorErase(vector, ind);
+  }
+  vectorElemT tmp = vector->data[ind];
+  vector->size--;
+  vector->data[ind] = vector->data[vector->size];
+  vector->data[vector->size] = NULL;
+  if(!ShrinkOnErase(vector)){
+    vector->data[vector->size] = vector->data[ind];
+    vector->data[ind] = tmp;
+    vector->size++;
+    return FAIL;
   }
   vector->elem_free_func(&tmp);
   return SUCCESS;
+}
+
+static int ShrinkOnErase(Vector *vector) {
 
+  if(vector->shrink_policy != VECTOR_SHRINK_ON_ERASE ||
+  VectorGetLoadFactor(vector) >= VECTOR_MIN_LOAD_FACTOR){
+    return SUCCESS;
+  }
+  CHECK_ERROR(ResizeArray(&(vector->data), (vector->capacity /
+  VECTOR_GROWTH_FACTOR) * sizeof(vectorElemT)), FAIL)
+  vector->capacity = vector->capacity / VECTOR_GROWTH_FACTOR;
+  return SUCCESS;
+}
+
+int VectorSetShrinkPolicy(Vector *vector, VectorShrinkPolicy shrink_policy){
+
+  CHECK_ERROR(vector, FAIL)
+  CHECK_ERROR(shrink_policy == VECTOR_SHRINK_ON_ERASE ||
+  shrink_policy == VECTOR_SHRINK_MANUAL, FAIL)
+  vector->shrink_policy = shrink_policy;
+  return SUCCESS;
+}
+
+int VectorShrinkToFit(Vector *vector){
+
+  CHECK_ERROR(vector, FAIL)
+  size_t new_capacity = VECTOR_INITIAL_CAP;
+  while((double)vector->size / new_capacity > VECTOR_MAX_LOAD_FACTOR){
+    new_capacity *= VECTOR_GROWTH_FACTOR;
+  }
+  if(new_capacity >= vector->capacity){
+    return SUCCESS;
+  }
+  CHECK_ERROR(ResizeArray(&(vector->data),
+  new_capacity * sizeof(vectorElemT)), FAIL)
+  vector->capacity = new_capacity;
+  return SUCCESS;
 }
 static void VectorOpenHole(Vector *vector, size_t ind) {
 
@@ -231,9 +403,6 @@ static void VectorCloseHole(Vector *vector, size_t ind) {
 
   CHECK_ERROR(vector, NO_RETURN_VALUE)
   CHECK_ERROR(ind < vector->size, NO_RETURN_VALUE)
-  if(ind == vector->size - 1){
-    return;
-  }
   size_t i = ind;
   for(; i < vector->size; i++){
     vector->data[i] = vector->data[i + 1];
@@ -241,10 +410,368 @@ static void VectorCloseHole(Vector *vector, size_t ind) {
   vector->data[i] = NULL;
 }
 
+static size_t CapacityAfterErasing(const Vector *vector, size_t num_erased) {
+
+  size_t new_capacity = vector->capacity;
+  if(vector->shrink_policy != VECTOR_SHRINK_ON_ERASE){
+    return new_capacity;
+  }
+  for(size_t size = vector->size; size > vector->size - num_erased; size--){
+    if((double)(size - 1) / new_capacity < VECTOR_MIN_LOAD_FACTOR &&
+    new_capacity > 1){
+      new_capacity /= VECTOR_GROWTH_FACTOR;
+    }
+  }
+  return new_capacity;
+}
+
+int VectorReserve(Vector *vector, size_t num_elems){
+
+  CHECK_ERROR(vector, FAIL)
+  size_t new_capacity = vector->capacity ? vector->capacity : 1;
+  while((double)num_elems / new_capacity > VECTOR_MAX_LOAD_FACTOR){
+    CHECK_ERROR(new_capacity <= ((size_t) -1) / VECTOR_GROWTH_FACTOR /
+    sizeof(vectorElemT), FAIL)
+    new_capacity *= VECTOR_GROWTH_FACTOR;
+  }
+  if(new_capacity <= vector->capacity){
+    return SUCCESS;
+  }
+  CHECK_ERROR(ResizeArray(&(vector->data),
+  new_capacity * sizeof(vectorElemT)), FAIL)
+  vector->capacity = new_capacity;
+  return SUCCESS;
+}
+
+static int CopyValuesTo(Vector *vector, size_t ind, void *const *values,
+                        size_t num_values) {
+
+  for(size_t i = 0; i < num_values; i++){
+    vector->data[ind + i] = values[i] ?
+        vector->elem_copy_func((const void*)values[i]) : NULL;
+    if(!vector->data[ind + i]){
+      while(i > 0){
+        i--;
+        vector->elem_free_func(&vector->data[ind + i]);
+      }
+      return FAIL;
+    }
+  }
+  return SUCCESS;
+}
+
+int VectorAppendRange(Vector *vector, void *const *values, size_t num_values){
+
+  CHECK_ERROR(vector, FAIL)
+  CHECK_ERROR(values || num_values == 0, FAIL)
+  CHECK_ERROR(VectorReserve(vector, vector->size + num_values), FAIL)
+  CHECK_ERROR(CopyValuesTo(vector, vector->size, values, num_values), FAIL)
+  size_t old_size = vector->size;
+  vector->size += num_values;
+  if(vector->order){
+    SortRun(&vector->data[old_size], num_values, vector->order);
+    vectorElemT *tmp = malloc(vector->size * sizeof(vectorElemT));
+    if(tmp){
+      MergeRuns(vector->data, tmp, old_size, vector->size, vector->order);
+      free(tmp);
+    } else {
+      SortRun(vector->data, vector->size, vector->order); //in place
+    }
+  }
+  return SUCCESS;
+}
+
+int VectorInsertRange(Vector *vector, size_t ind, void *const *values,
+                      size_t num_values){
+
+  CHECK_ERROR(vector, FAIL)
+  CHECK_ERROR(ind <= vector->size, FAIL)
+  CHECK_ERROR(!vector->order, FAIL)
+  CHECK_ERROR(values || num_values == 0, FAIL)
+  CHECK_ERROR(VectorReserve(vector, vector->size + num_values), FAIL)
+  size_t num_moved = vector->size - ind;
+  memmove(&vector->data[ind + num_values], &vector->data[ind],
+          num_moved * sizeof(vectorElemT));
+  if(!CopyValuesTo(vector, ind, values, num_values)){
+    memmove(&vector->data[ind], &vector->data[ind + num_values],
+            num_moved * sizeof(vectorElemT));
+    return FAIL;
+  }
+  vector->size += num_values;
+  return SUCCESS;
+}
+
+int VectorEraseRange(Vector *vector, size_t from, size_t to){
+
+  CHECK_ERROR(vector, FAIL)
+  CHECK_ERROR(from <= to && to <= vector->size, FAIL)
+  size_t new_capacity = CapacityAfterErasing(vector, to - from);
+  for(size_t i = from; i < to; i++){
+    vector->elem_free_func(&vector->data[i]);
+  }
+  memmove(&vector->data[from], &vector->data[to],
+          (vector->size - to) * sizeof(vectorElemT));
+  vector->size -= to - from;
+  //the elements are gone either way- if shrinking fails keep the capacity
+  if(new_capacity != vector->capacity &&
+  ResizeArray(&(vector->data), new_capacity * sizeof(vectorElemT))){
+    vector->capacity = new_capacity;
+  }
+  return SUCCESS;
+}
+
+static size_t BinarySearch(vectorElemT *data, size_t size, const void *value,
+                           VectorElemOrder order, int strict) {
+
+  size_t low = 0, high = size;
+  while(low < high){
+    size_t mid = low + (high - low) / 2;
+    int cmp = order(data[mid], value);
+    if(cmp < 0 || (strict && cmp == 0)){
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+size_t VectorLowerBound(Vector *vector, const void *value){
+
+  CHECK_ERROR(vector, 0)
+  CHECK_ERROR(vector->order && value, vector->size)
+  return BinarySearch(vector->data, vector->size, value, vector->order, 0);
+}
+
+static void InsertionSort(vectorElemT *data, size_t size,
+                          VectorElemOrder order) {
+
+  for(size_t i = 1; i < size; i++){
+    vectorElemT cur = data[i];
+    size_t j = i;
+    for(; j > 0 && order(data[j - 1], cur) > 0; j--){
+      data[j] = data[j - 1];
+    }
+    data[j] = cur;
+  }
+}
+
+static void HeapSort(vectorElemT *data, size_t size, VectorElemOrder order) {
+
+  for(size_t end = size, start = size / 2; end > 1;){
+    size_t root;
+    if(start > 0){
+      root = --start; //building the heap
+    } else {
+      end--; //the max goes to the end
+      vectorElemT tmp = data[0];
+      data[0] = data[end];
+      data[end] = tmp;
+      root = 0;
+    }
+    //sift the root down
+    for(size_t child = 2 * root + 1; child < end; child = 2 * root + 1){
+      if(child + 1 < end && order(data[child], data[child + 1]) < 0){
+        child++;
+      }
+      if(order(data[root], data[child]) >= 0){
+        break;
+      }
+      vectorElemT tmp = data[root];
+      data[root] = data[child];
+      data[child] = tmp;
+      root = child;
+    }
+  }
+}
+
+static void IntroSort(vectorElemT *data, size_t size, VectorElemOrder order,
+                      size_t depth_limit) {
+
+  while(size > INSERTION_SORT_MAX){
+    if(depth_limit == 0){
+      HeapSort(data, size, order);
+      return;
+    }
+    depth_limit--;
+    //median of three- data[0] <= pivot <= data[size - 1] bound both scans
+    size_t mid = size / 2;
+    vectorElemT tmp;
+    if(order(data[mid], data[0]) < 0){
+      tmp = data[mid]; data[mid] = data[0]; data[0] = tmp;
+    }
+    if(order(data[size - 1], data[mid]) < 0){
+      tmp = data[size - 1]; data[size - 1] = data[mid]; data[mid] = tmp;
+      if(order(data[mid], data[0]) < 0){
+        tmp = data[mid]; data[mid] = data[0]; data[0] = tmp;
+      }
+    }
+    vectorElemT pivot = data[mid];
+    //Hoare partition: data[0, split) <= pivot <= data[split, size)
+    size_t i = 0, j = size - 1;
+    for(;;){
+      while(order(data[i], pivot) < 0){
+        i++;
+      }
+      while(order(pivot, data[j]) < 0){
+        j--;
+      }
+      if(i >= j){
+        break;
+      }
+      tmp = data[i]; data[i] = data[j]; data[j] = tmp;
+      i++;
+      j--;
+    }
+    size_t split = j + 1;
+    //recurse into the smaller part, loop on the bigger one
+    if(split < size - split){
+      IntroSort(data, split, order, depth_limit);
+      data += split;
+      size -= split;
+    } else {
+      IntroSort(data + split, size - split, order, depth_limit);
+      size = split;
+    }
+  }
+  InsertionSort(data, size, order);
+}
+
+static void SortRun(vectorElemT *data, size_t size, VectorElemOrder order) {
+
+  size_t depth_limit = 0;
+  for(size_t n = size; n > 1; n /= 2){
+    depth_limit += 2;
+  }
+  IntroSort(data, size, order, depth_limit);
+}
+
+static void MergeRuns(vectorElemT *data, vectorElemT *tmp, size_t mid,
+                      size_t size, VectorElemOrder order) {
+
+  size_t i = 0, j = mid, k = 0;
+  while(i < mid && j < size){
+    tmp[k++] = order(data[j], data[i]) < 0 ? data[j++] : data[i++];
+  }
+  while(i < mid){
+    tmp[k++] = data[i++];
+  }
+  //the rest of the second run is already in place
+  memcpy(data, tmp, k * sizeof(vectorElemT));
+}
+
+#ifdef VECTOR_PARALLEL_SORT
+/**
+ * @struct SortTask
+ * A run to sort (mid == 0) or two runs to merge, for one thread.
+ */
+typedef struct SortTask {
+  vectorElemT *data;
+  vectorElemT *tmp;
+  size_t mid;
+  size_t size;
+  VectorElemOrder order;
+} SortTask;
+
+/**
+ * thread function of ParallelSort- runs a SortTask
+ */
+static void *RunSortTask(void *arg) {
+
+  SortTask *task = (SortTask *) arg;
+  if(task->mid == 0){
+    SortRun(task->data, task->size, task->order);
+  } else {
+    MergeRuns(task->data, task->tmp, task->mid, task->size, task->order);
+  }
+  return NULL;
+}
+
+static int ParallelSort(vectorElemT *data, size_t size,
+                        VectorElemOrder order) {
+
+  vectorElemT *tmp = malloc(size * sizeof(vectorElemT));
+  CHECK_ERROR(tmp, FAIL)
+  SortTask tasks[VECTOR_SORT_THREADS];
+  pthread_t threads[VECTOR_SORT_THREADS];
+  size_t run = (size + VECTOR_SORT_THREADS - 1) / VECTOR_SORT_THREADS;
+  //first the runs are sorted, then every level merges pairs of runs
+  for(size_t width = 0; width == 0 || width < size; width = width ?
+      width * 2 : run){
+    size_t num_tasks = 0;
+    size_t step = width ? 2 * width : run;
+    for(size_t from = 0; from < size; from += step){
+      size_t to = from + step < size ? from + step : size;
+      size_t mid = width && from + width < to ? width : 0;
+      if(width && !mid){
+        continue; //a lone run on this level, already sorted
+      }
+      SortTask task = {data + from, tmp + from, mid, to - from, order};
+      tasks[num_tasks] = task;
+      num_tasks++;
+    }
+    int started[VECTOR_SORT_THREADS];
+    for(size_t i = 0; i < num_tasks; i++){
+      started[i] = pthread_create(&threads[i], NULL, RunSortTask,
+                                  &tasks[i]) == 0;
+      if(!started[i]){
+        RunSortTask(&tasks[i]); //no thread- do it here
+      }
+    }
+    for(size_t i = 0; i < num_tasks; i++){
+      if(started[i]){
+        pthread_join(threads[i], NULL);
+      }
+    }
+  }
+  free(tmp);
+  return SUCCESS;
+}
+#endif
+
+int VectorSort(Vector *vector, VectorElemOrder order){
+
+  CHECK_ERROR(vector && order, FAIL)
+  if(order != vector->order){
+    vector->order = NULL; //sorted by another order
+  }
+#ifdef VECTOR_PARALLEL_SORT
+  if(vector->size >= VECTOR_PARALLEL_SORT_MIN &&
+  ParallelSort(vector->data, vector->size, order)){
+    return SUCCESS;
+  }
+#endif
+  SortRun(vector->data, vector->size, order);
+  return SUCCESS;
+}
+
+int VectorSetSorted(Vector *vector, VectorElemOrder order){
+
+  CHECK_ERROR(vector, FAIL)
+  if(order && order != vector->order){
+    CHECK_ERROR(VectorSort(vector, order), FAIL)
+  }
+  vector->order = order;
+  return SUCCESS;
+}
+
 void VectorClear(Vector *vector){
 
   CHECK_ERROR(vector, NO_RETURN_VALUE)
-  while(vector->size != 0){
-    VectorErase(vector, vector->size - 1);
+  size_t new_capacity = CapacityAfterErasing(vector, vector->size);
+  VectorClearKeepCapacity(vector);
+  //the elements are gone either way- if shrinking fails keep the capacity
+  if(new_capacity != vector->capacity &&
+  ResizeArray(&(vector->data), new_capacity * sizeof(vectorElemT))){
+    vector->capacity = new_capacity;
   }
 }
+
+void VectorClearKeepCapacity(Vector *vector){
+
+  CHECK_ERROR(vector, NO_RETURN_VALUE)
+  for(size_t i = 0; i < vector->size; i++){
+    vector->elem_free_func(&vector->data[i]);
+  }
+  vector->size = 0;
+}
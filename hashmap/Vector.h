@@ -29,6 +29,20 @@
  */
 #define VECTOR_MIN_LOAD_FACTOR 0.25
 
+/**
+ * @enum VectorShrinkPolicy
+ * When a vector gives memory back.
+ * VECTOR_SHRINK_ON_ERASE - an erase halves the capacity when the load factor
+ * drops below VECTOR_MIN_LOAD_FACTOR (the default).
+ * VECTOR_SHRINK_MANUAL - erasing never shrinks the vector, only
+ * VectorShrinkToFit does, so a vector that is emptied and refilled again and
+ * again is not reallocated on every cycle.
+ */
+typedef enum VectorShrinkPolicy {
+  VECTOR_SHRINK_ON_ERASE,
+  VECTOR_SHRINK_MANUAL,
+} VectorShrinkPolicy;
+
 /**
  * @typedef VectorElemCpy
  * Function which receive an element stored in the vector
@@ -50,6 +64,28 @@ typedef int (*VectorElemCmp)(const void *, const void *);
  */
 typedef void (*VectorElemFree)(void **);
 
+/**
+ * @typedef VectorElemOrder
+ * Function which receives two elements stored in the vector and returns a
+ * negative number if the first comes before the second, 0 if they are
+ * equivalent and a positive number otherwise.
+ */
+typedef int (*VectorElemOrder)(const void *, const void *);
+
+/**
+ * @def VECTOR_PARALLEL_SORT_MIN
+ * The smallest vector VectorSort sorts with parallel merge sort (only when
+ * compiled with -DVECTOR_PARALLEL_SORT, which needs -pthread).
+ */
+#define VECTOR_PARALLEL_SORT_MIN 65536UL
+
+/**
+ * @def VECTOR_SORT_THREADS
+ * The number of threads (and sorted runs) of the parallel merge sort, a
+ * power of 2.
+ */
+#define VECTOR_SORT_THREADS 4UL
+
 /**
  * @struct Vector - a generic vector struct.
  * @param capacity - the capacity of the vector.
@@ -61,6 +97,9 @@ typedef void (*VectorElemFree)(void **);
  * stored in the vector.
  * @param elem_free_func - a function which frees the elements stored
  * in the vector.
+ * @param shrink_policy - when the vector shrinks.
+ * @param order - the order the elements are kept in, NULL if the vector is
+ * not sorted (see VectorSetSorted).
  */
 typedef struct Vector {
   size_t capacity;
@@ -69,6 +108,8 @@ typedef struct Vector {
   VectorElemCpy elem_copy_func;
   VectorElemCmp elem_cmp_func;
   VectorElemFree elem_free_func;
+  VectorShrinkPolicy shrink_policy;
+  VectorElemOrder order;
 } Vector;
 
 /**
@@ -98,7 +139,8 @@ void VectorFree(Vector **p_vector);
 void *VectorAt(Vector *vector, size_t ind);
 
 /**
- * Gets a value and checks if the value is in the vector.
+ * Gets a value and checks if the value is in the vector. A sorted vector is
+ * binary searched.
  * @param vector a pointer to vector.
  * @param value the value to look for.
  * @return the index of the given value if it is in the
@@ -108,13 +150,24 @@ void *VectorAt(Vector *vector, size_t ind);
 int VectorFind(Vector *vector, void *value);
 
 /**
- * Adds a new value to the back (index vector_size) of the vector.
+ * Adds a new value to the back (index vector_size) of the vector, or, if the
+ * vector is sorted, after the last element not ordered after it.
  * @param vector a pointer to vector.
  * @param value the value to be added to the vector.
  * @return 1 if the adding has been done successfully, 0 otherwise.
  */
 int VectorPushBack(Vector *vector, void *value);
 
+/**
+ * Adds a value to the back of the vector without copying it - the vector
+ * takes ownership of the value and frees it with elem_free_func.
+ * @param vector a pointer to vector.
+ * @param value dynamically allocated value to be added to the vector.
+ * @return 1 if the adding has been done successfully, 0 otherwise (the
+ * value is then still owned by the caller).
+ */
+int VectorPushBackOwned(Vector *vector, void *value);
+
 /**
  * This function returns the load factor of the vector.
  * @param vector a vector.
@@ -131,9 +184,124 @@ double VectorGetLoadFactor(Vector *vector);
 int VectorErase(Vector *vector, size_t ind);
 
 /**
- * Deletes all the elements in the vector.
+ * Makes room for num_elems elements, so pushing up to that many never
+ * reallocates (one reallocation at most). Never shrinks the vector.
+ * @param vector a pointer to vector.
+ * @param num_elems the number of elements the vector should hold.
+ * @return 1 upon success (also if the vector is already big enough), 0
+ * otherwise.
+ */
+int VectorReserve(Vector *vector, size_t num_elems);
+
+/**
+ * Adds copies of num_values values to the back of the vector, growing it
+ * once.
+ * @param vector a pointer to vector.
+ * @param values the values to be added.
+ * @param num_values the number of values.
+ * @return 1 if the adding has been done successfully, 0 otherwise (no value
+ * is added). A sorted vector merges the values in, in order.
+ */
+int VectorAppendRange(Vector *vector, void *const *values, size_t num_values);
+
+/**
+ * Inserts copies of num_values values at the given index, moving the
+ * elements from it on (with one memmove) to after them.
+ * @param vector a pointer to vector.
+ * @param ind the index of the first inserted value ([0, vector_size]).
+ * @param values the values to be inserted.
+ * @param num_values the number of values.
+ * @return 1 if the inserting has been done successfully, 0 otherwise (no
+ * value is inserted). Fails on a sorted vector.
+ */
+int VectorInsertRange(Vector *vector, size_t ind, void *const *values,
+                      size_t num_values);
+
+/**
+ * Removes the elements in [from, to) from the vector, moving the elements
+ * after them back with one memmove. A vector that shrinks on erase ends
+ * with the capacity erasing them one by one would leave it with.
+ * @param vector a pointer to vector.
+ * @param from the index of the first element to be removed.
+ * @param to the index after the last element to be removed.
+ * @return 1 if the removing has been done successfully, 0 otherwise.
+ */
+int VectorEraseRange(Vector *vector, size_t from, size_t to);
+
+/**
+ * Removes the element at the given index from the vector by moving the last
+ * element into its place, so it takes O(1) instead of shifting every later
+ * element (the order of the remaining elements is not kept). A sorted
+ * vector erases in order (VectorErase).
+ * @param vector a pointer to vector.
+ * @param ind the index of the element to be removed.
+ * @return 1 if the removing has been done successfully, 0 otherwise.
+ */
+int VectorEraseUnordered(Vector *vector, size_t ind);
+
+/**
+ * Sets when the vector shrinks (see VectorShrinkPolicy).
+ * @param vector a pointer to vector.
+ * @param shrink_policy the policy.
+ * @return 1 upon success, 0 otherwise.
+ */
+int VectorSetShrinkPolicy(Vector *vector, VectorShrinkPolicy shrink_policy);
+
+/**
+ * Shrinks the vector to the smallest capacity (not below VECTOR_INITIAL_CAP)
+ * that holds its elements within VECTOR_MAX_LOAD_FACTOR. Never grows it.
+ * @param vector a pointer to vector.
+ * @return 1 upon success (also if the vector is already small enough), 0
+ * otherwise.
+ */
+int VectorShrinkToFit(Vector *vector);
+
+/**
+ * Sorts the elements of the vector: introsort (quicksort that falls back to
+ * heapsort on bad pivots, insertion sort on short runs), or, for vectors of
+ * at least VECTOR_PARALLEL_SORT_MIN elements when compiled with
+ * VECTOR_PARALLEL_SORT, VECTOR_SORT_THREADS runs introsorted in parallel and
+ * merged. Not stable. A sorted vector sorted by another order is no longer
+ * sorted (VectorSetSorted).
+ * @param vector a pointer to vector.
+ * @param order the order to sort by.
+ * @return 1 upon success, 0 otherwise.
+ */
+int VectorSort(Vector *vector, VectorElemOrder order);
+
+/**
+ * Sorts the vector and keeps it sorted: VectorFind and VectorLowerBound
+ * binary search it and new values are inserted in order. The elements must
+ * not be changed in a way that changes their order.
+ * @param vector a pointer to vector.
+ * @param order the order to keep, NULL to stop keeping one.
+ * @return 1 upon success, 0 otherwise.
+ */
+int VectorSetSorted(Vector *vector, VectorElemOrder order);
+
+/**
+ * Returns the index of the first element of a sorted vector that is not
+ * ordered before the given value, in O(log n).
+ * @param vector a pointer to a sorted vector.
+ * @param value the value to look for.
+ * @return the index, vector_size if every element comes before value (or
+ * the vector is not sorted).
+ */
+size_t VectorLowerBound(Vector *vector, const void *value);
+
+/**
+ * Deletes all the elements in the vector, in one pass. A vector that shrinks
+ * on erase ends with the capacity erasing them one by one would leave it
+ * with (reallocated once), a VECTOR_SHRINK_MANUAL vector keeps its capacity.
  * @param vector vector a pointer to vector.
  */
 void VectorClear(Vector *vector);
 
+/**
+ * Deletes all the elements in the vector, in one pass, and keeps its
+ * capacity whatever its shrink policy.
+ * @param vector a pointer to vector.
+ */
+void VectorClearKeepCapacity(Vector *vector);
+
 #endif //VECTOR_H_
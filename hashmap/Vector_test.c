@@ -2,10 +2,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include "Vector.h"
+#include "TypedVector.h"
 
 enum errors{SUCCESS, TEST1FAIL, TEST2FAIL, TEST3FAIL, TEST4FAIL, TEST5FAIL,
-    TEST6FAIL};
+    TEST6FAIL, TEST7FAIL, TEST8FAIL, TEST9FAIL, TEST10FAIL,
+    TEST11FAIL, TEST12FAIL, TEST13FAIL};
+
+DEFINE_VECTOR(IntVector, int)
+DEFINE_VECTOR_FIND(IntVector, int, TypedVectorFindInt, TypedVectorCountInt)
+
 int IntCompare(const void* val1, const void* val2);
+int IntOrder(const void* val1, const void* val2);
 void* IntCopy(const void* val);
 void IntFree(void **to_free);
 
@@ -16,6 +23,13 @@ int Test3();
 int Test4();
 int Test5();
 int Test6();
+int Test7();
+int Test8();
+int Test9();
+int Test10();
+int Test11();
+int Test12();
+int Test13();
 int main()
 {
   printf("TEST 1: VectorAlloc\n");
@@ -68,9 +82,364 @@ int main()
     exit(6);
   }
   printf("TEST 6 PASSED!\n\n");
+
+  printf("TEST 7: VectorEraseUnordered + VectorShrinkToFit\n");
+  int result_test7 = Test7();
+  if(result_test7 != 0){
+    fprintf(stderr, "Test 7 FAILED!\n\n");
+    exit(7);
+  }
+  printf("TEST 7 PASSED!\n\n");
+
+  printf("TEST 8: VectorClearKeepCapacity\n");
+  int result_test8 = Test8();
+  if(result_test8 != 0){
+    fprintf(stderr, "Test 8 FAILED!\n\n");
+    exit(8);
+  }
+  printf("TEST 8 PASSED!\n\n");
+
+  printf("TEST 9: DEFINE_VECTOR (int)\n");
+  int result_test9 = Test9();
+  if(result_test9 != 0){
+    fprintf(stderr, "Test 9 FAILED!\n\n");
+    exit(9);
+  }
+  printf("TEST 9 PASSED!\n\n");
+
+  printf("TEST 10: typed vector find + count\n");
+  int result_test10 = Test10();
+  if(result_test10 != 0){
+    fprintf(stderr, "Test 10 FAILED!\n\n");
+    exit(10);
+  }
+  printf("TEST 10 PASSED!\n\n");
+
+  printf("TEST 11: VectorReserve + range operations\n");
+  int result_test11 = Test11();
+  if(result_test11 != 0){
+    fprintf(stderr, "Test 11 FAILED!\n\n");
+    exit(11);
+  }
+  printf("TEST 11 PASSED!\n\n");
+
+  printf("TEST 12: sorted vector\n");
+  int result_test12 = Test12();
+  if(result_test12 != 0){
+    fprintf(stderr, "Test 12 FAILED!\n\n");
+    exit(12);
+  }
+  printf("TEST 12 PASSED!\n\n");
+
+  printf("TEST 13: VectorPushBackOwned\n");
+  int result_test13 = Test13();
+  if(result_test13 != 0){
+    fprintf(stderr, "Test 13 FAILED!\n\n");
+    exit(13);
+  }
+  printf("TEST 13 PASSED!\n\n");
   printf("ALL TESTS PASSED :)\n");
 }
 
+int Test13() {
+  Vector *vec = VectorAlloc(IntCopy, IntCompare, IntFree);
+  int value = 5;
+  void *owned = IntCopy(&value);
+  void *kept = IntCopy(&value);
+  //the vector keeps the pointer itself (no copy) and frees it in VectorFree
+  int fail_flag = !vec || !owned || !kept ||
+      VectorPushBackOwned(vec, owned) != 1 || vec->size != 1 ||
+      vec->data[0] != owned;
+  //on failure the value is still the caller's- it frees it itself
+  fail_flag = fail_flag || VectorPushBackOwned(NULL, kept) != 0 ||
+      VectorPushBackOwned(vec, NULL) != 0 || vec->size != 1;
+  free(kept);
+  //a sorted vector puts the owned value in its place
+  fail_flag = fail_flag || VectorSetSorted(vec, IntOrder) != 1;
+  for(int i = 4; i >= 0 && !fail_flag; i--){
+    value = i;
+    void *cur = IntCopy(&value);
+    if(!cur || VectorPushBackOwned(vec, cur) != 1){
+      free(cur);
+      fail_flag = 1;
+    }
+    fail_flag = fail_flag || vec->data[0] != cur || vec->data[5 - i] != owned;
+  }
+  VectorFree(&vec);
+  if(fail_flag){
+    fprintf(stderr, "TEST 13: VectorPushBackOwned did not take ownership\n");
+    return TEST13FAIL;
+  }
+  return SUCCESS;
+}
+
+int Test12() {
+  Vector *vec = VectorAlloc(IntCopy, IntCompare, IntFree);
+  if(!vec){
+    fprintf(stderr, "TEST 12: vector allocation failed\n");
+    return TEST12FAIL;
+  }
+  int num_arr[100];
+  void *num_p_array[100];
+  for(int i = 0; i < 100; i++){
+    num_arr[i] = (i * 37) % 50; //every value twice, out of order
+    num_p_array[i] = &num_arr[i];
+    VectorPushBack(vec, &num_arr[i]);
+  }
+  int fail_flag = VectorSetSorted(vec, IntOrder) != 1 ||
+      VectorInsertRange(vec, 0, num_p_array, 1) != 0 ||
+      VectorAppendRange(vec, num_p_array, 100) != 1 || vec->size != 200;
+  int value = 120;
+  VectorPushBack(vec, &value);
+  value = -1;
+  VectorPushBack(vec, &value);
+  value = 7;
+  fail_flag = fail_flag || vec->size != 202 ||
+      *((int*)vec->data[0]) != -1 || *((int*)vec->data[201]) != 120 ||
+      VectorLowerBound(vec, &value) != 29 ||
+      *((int*)vec->data[VectorFind(vec, &value)]) != 7;
+  for(size_t i = 1; i < vec->size && !fail_flag; i++){
+    fail_flag = IntOrder(vec->data[i - 1], vec->data[i]) > 0;
+  }
+  //erasing in sorted mode keeps the order
+  VectorEraseUnordered(vec, 0);
+  value = 51;
+  if(fail_flag || *((int*)vec->data[0]) != 0 ||
+  *((int*)vec->data[200]) != 120 || VectorFind(vec, &value) != -1){
+    fprintf(stderr, "TEST 12: sorted vector is not in order\n");
+    VectorFree(&vec);
+    return TEST12FAIL;
+  }
+  //a big vector (sorted in parallel with VECTOR_PARALLEL_SORT)
+  VectorSetSorted(vec, NULL);
+  VectorClear(vec);
+  for(int i = 0; i < 70000; i++){
+    value = (int)(((unsigned)i * 2654435761u) % 100000u);
+    VectorPushBack(vec, &value);
+  }
+  fail_flag = VectorSort(vec, IntOrder) != 1 || vec->order ||
+      vec->size != 70000;
+  for(size_t i = 1; i < vec->size && !fail_flag; i++){
+    fail_flag = IntOrder(vec->data[i - 1], vec->data[i]) > 0;
+  }
+  VectorFree(&vec);
+  if(fail_flag){
+    fprintf(stderr, "TEST 12: VectorSort did not sort\n");
+    return TEST12FAIL;
+  }
+  return SUCCESS;
+}
+
+int Test11() {
+  Vector *vec = VectorAlloc(IntCopy, IntCompare, IntFree);
+  Vector *one_by_one = VectorAlloc(IntCopy, IntCompare, IntFree);
+  int num_arr[100];
+  void *num_p_array[100];
+  for(int i = 0; i < 100; i++){
+    num_arr[i] = i;
+    num_p_array[i] = &num_arr[i];
+  }
+  int fail_flag = !vec || !one_by_one ||
+      VectorAppendRange(vec, num_p_array, 100) != 1 || vec->size != 100 ||
+      vec->capacity != 256 || VectorReserve(vec, 1000) != 1 ||
+      vec->capacity != 2048 || VectorReserve(vec, 10) != 1 ||
+      vec->capacity != 2048 || VectorInsertRange(vec, 101, num_p_array, 1)
+      != 0 || VectorInsertRange(vec, 50, num_p_array, 10) != 1 ||
+      vec->size != 110;
+  //0..49, 0..9, 50..99
+  for(int i = 0; i < 110 && !fail_flag; i++){
+    int expected = i < 50 ? i : i < 60 ? i - 50 : i - 10;
+    fail_flag = *((int*)vec->data[i]) != expected;
+  }
+  if(fail_flag || VectorEraseRange(vec, 60, 111) != 0 ||
+  VectorEraseRange(vec, 50, 60) != 1 || vec->size != 100 ||
+  *((int*)vec->data[50]) != 50){
+    fprintf(stderr, "TEST 11: range operations returned wrong values\n");
+    VectorFree(&vec);
+    VectorFree(&one_by_one);
+    return TEST11FAIL;
+  }
+  //erasing a range shrinks like erasing its elements one by one
+  VectorAppendRange(one_by_one, num_p_array, 100);
+  VectorReserve(one_by_one, 1000);
+  for(int i = 0; i < 95 && !fail_flag; i++){
+    fail_flag = VectorErase(one_by_one, 0) != 1;
+  }
+  if(fail_flag || VectorEraseRange(vec, 0, 95) != 1 || vec->size != 5 ||
+  vec->capacity != one_by_one->capacity || *((int*)vec->data[0]) != 95){
+    fprintf(stderr, "TEST 11: vector have not been resized correctly\n");
+    VectorFree(&vec);
+    VectorFree(&one_by_one);
+    return TEST11FAIL;
+  }
+  VectorFree(&vec);
+  VectorFree(&one_by_one);
+  return SUCCESS;
+}
+
+int Test10() {
+  IntVector *vec = IntVectorAlloc();
+  if(!vec){
+    fprintf(stderr, "TEST 10: int_vec allocation failed\n");
+    return TEST10FAIL;
+  }
+  int fail_flag = 0;
+  for(int i = 0; i < 1001 && !fail_flag; i++){
+    fail_flag = IntVectorPushBack(vec, i % 7) != 1;
+  }
+  //every index of a 3, in order, both from the groups and from the tail
+  size_t found = 0, expected = 3;
+  for(size_t i = IntVectorFind(vec, 3, 0); i < vec->size && !fail_flag;
+      i = IntVectorFind(vec, 3, i + 1)){
+    fail_flag = i != expected;
+    expected += 7;
+    found++;
+  }
+  if(fail_flag || found != 143 || IntVectorCount(vec, 3) != 143 ||
+  IntVectorCount(vec, 0) != 143 || IntVectorCount(vec, 7) != 0 ||
+  IntVectorFind(vec, 7, 0) != vec->size ||
+  IntVectorFind(vec, 0, 995) != 1001 - 1001 % 7){
+    fprintf(stderr, "TEST 10: typed vector find returned wrong values\n");
+    IntVectorFree(&vec);
+    return TEST10FAIL;
+  }
+  IntVectorFree(&vec);
+
+  double doubles[37];
+  char chars[70];
+  for(int i = 0; i < 70; i++){
+    chars[i] = (char)('a' + i % 3);
+    if(i < 37){
+      doubles[i] = i / 4.0;
+    }
+  }
+  if(TypedVectorFindDouble(doubles, 37, 8.75, 0) != 35 ||
+  TypedVectorFindDouble(doubles, 37, 0.1, 0) != 37 ||
+  TypedVectorCountDouble(doubles, 37, 0.5) != 1 ||
+  TypedVectorFindChar(chars, 70, 'c', 3) != 5 ||
+  TypedVectorCountChar(chars, 70, 'b') != 23 ||
+  TypedVectorFindChar(chars, 70, 'a', 69) != 69){
+    fprintf(stderr, "TEST 10: typed find returned wrong values\n");
+    return TEST10FAIL;
+  }
+  return SUCCESS;
+}
+
+int Test9() {
+  IntVector *vec = IntVectorAlloc();
+  if(!vec){
+    fprintf(stderr, "TEST 9: int_vec allocation failed\n");
+    return TEST9FAIL;
+  }
+  int fail_flag = 0;
+  for(int i = 0; i < 1000 && !fail_flag; i++){
+    if(i % 2){
+      fail_flag = IntVectorPushBack(vec, i) != 1;
+    } else {
+      int *slot = IntVectorEmplaceBack(vec);
+      fail_flag = !slot;
+      if(slot){
+        *slot = i;
+      }
+    }
+  }
+  for(int i = 0; i < 1000 && !fail_flag; i++){
+    fail_flag = !IntVectorAt(vec, i) || *IntVectorAt(vec, i) != i;
+  }
+  //ordered erase shifts, unordered erase takes the last element
+  if(fail_flag || IntVectorAt(vec, 1000) || vec->capacity != 1024 ||
+  IntVectorErase(vec, 1000) != 0 || IntVectorErase(vec, 0) != 1 ||
+  *IntVectorAt(vec, 0) != 1 || IntVectorEraseUnordered(vec, 0) != 1 ||
+  *IntVectorAt(vec, 0) != 999 || vec->size != 998){
+    fprintf(stderr, "TEST 9: typed vector returned wrong values\n");
+    IntVectorFree(&vec);
+    return TEST9FAIL;
+  }
+  IntVectorClear(vec);
+  if(vec->size != 0 || vec->capacity != 1024 ||
+  IntVectorShrinkToFit(vec) != 1 || vec->capacity != VECTOR_INITIAL_CAP ||
+  IntVectorReserve(vec, 100) != 1 || vec->capacity != 128){
+    fprintf(stderr, "TEST 9: typed vector have not been resized correctly\n");
+    IntVectorFree(&vec);
+    return TEST9FAIL;
+  }
+  IntVectorFree(&vec);
+  return SUCCESS;
+}
+
+int Test8() {
+  Vector *vec = VectorAlloc(IntCopy, IntCompare, IntFree);
+  if(!vec){
+    fprintf(stderr, "TEST 8: int_vec allocation failed\n");
+    return TEST8FAIL;
+  }
+  int fail_flag = 0;
+  for(int round = 0; round < 3 && !fail_flag; round++){
+    for(int i = 1; i <= 100 && !fail_flag; i++){
+      fail_flag = VectorPushBack(vec, &i) != 1;
+    }
+    VectorClearKeepCapacity(vec);
+    fail_flag = fail_flag || vec->size != 0 || vec->capacity != 256;
+  }
+  //a manual vector keeps its capacity through VectorClear as well
+  VectorSetShrinkPolicy(vec, VECTOR_SHRINK_MANUAL);
+  for(int i = 1; i <= 10 && !fail_flag; i++){
+    fail_flag = VectorPushBack(vec, &i) != 1;
+  }
+  VectorClear(vec);
+  if(fail_flag || vec->size != 0 || vec->capacity != 256){
+    fprintf(stderr, "TEST 8: clearing changed the capacity\n");
+    VectorFree(&vec);
+    return TEST8FAIL;
+  }
+  VectorFree(&vec);
+  return SUCCESS;
+}
+
+int Test7() {
+  Vector *vec = VectorAlloc(IntCopy, IntCompare, IntFree);
+  if(!vec || VectorSetShrinkPolicy(vec, VECTOR_SHRINK_MANUAL) != 1){
+    VectorFree(&vec);
+    fprintf(stderr, "TEST 7: int_vec allocation failed\n");
+    return TEST7FAIL;
+  }
+  int fail_flag = 0;
+  for(int i = 1; i <= 100 && !fail_flag; i++){
+    fail_flag = VectorPushBack(vec, &i) != 1;
+  }
+  //the last element fills the hole
+  if(fail_flag || VectorEraseUnordered(vec, 100) != 0 ||
+  VectorEraseUnordered(vec, 0) != 1 || vec->size != 99 ||
+  *((int*)vec->data[0]) != 100){
+    fprintf(stderr, "TEST 7: unordered erase failed\n");
+    VectorFree(&vec);
+    return TEST7FAIL;
+  }
+  //erasing from the front never shrinks a manual vector
+  while(vec->size > 9 && !fail_flag){
+    fail_flag = VectorEraseUnordered(vec, 0) != 1 || vec->capacity != 256;
+  }
+  if(fail_flag || VectorShrinkToFit(vec) != 1 || vec->capacity != 16 ||
+  VectorShrinkToFit(vec) != 1 || vec->capacity != 16){
+    fprintf(stderr, "TEST 7: vector have not been resized correctly\n");
+    VectorFree(&vec);
+    return TEST7FAIL;
+  }
+  //shrinking on erase again
+  VectorSetShrinkPolicy(vec, VECTOR_SHRINK_ON_ERASE);
+  while(vec->size > 3 && !fail_flag){
+    fail_flag = VectorEraseUnordered(vec, vec->size / 2) != 1;
+  }
+  if(fail_flag || vec->capacity != 8){
+    fprintf(stderr, "TEST 7: vector have not been resized correctly after "
+                    "deleting elements\n");
+    VectorFree(&vec);
+    return TEST7FAIL;
+  }
+  VectorFree(&vec);
+  return SUCCESS;
+}
+
 int Test6() {
   Vector *vec = VectorAlloc(IntCopy, IntCompare, IntFree);
   if(!vec){
@@ -375,6 +744,11 @@ int IntCompare(const void* val1, const void* val2){
   return int1 == int2 ? 1 : 0;
 }
 
+int IntOrder(const void* val1, const void* val2){
+  int a = *((int*)val1), b = *((int*)val2);
+  return (a > b) - (a < b);
+}
+
 void* IntCopy(const void* val){
   if(!val){
     fprintf(stderr, "IntCopy got NULL data\n");